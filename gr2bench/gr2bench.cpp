@@ -0,0 +1,454 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2026, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+
+Description:
+Shapes text corpora with their fonts and reports throughput and per segment
+latency, for tracking performance from one build to the next.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#if !defined GRAPHITE2_NTHREADS
+#include <thread>
+#endif
+
+#include "graphite2/Font.h"
+#include "graphite2/Segment.h"
+
+namespace
+{
+
+typedef std::chrono::steady_clock timer;
+
+struct Job
+{
+    std::string font;
+    std::string text;
+    bool        rtl;
+};
+
+// The fonts that have a corpus to go with them, as used by the cmptest tests.
+const struct { const char * font, * text; bool rtl; } default_jobs[] =
+{
+    {"Padauk.ttf",                  "my_HeadwordSyllables.txt", false},
+    {"charis_r_gr.ttf",             "udhr_eng.txt",             false},
+    {"charis_r_gr.ttf",             "udhr_yor.txt",             false},
+    {"Annapurnarc2.ttf",            "udhr_nep.txt",             false},
+    {"Scheherazadegr.ttf",          "udhr_arb.txt",             true},
+    {"Awami_test.ttf",              "awami_tests.txt",          true},
+    {"Awami_compressed_test.ttf",   "awami_tests.txt",          true},
+};
+
+enum Format { TEXT, CSV, JSON };
+
+struct Parameters
+{
+    std::string         dir;
+    std::vector<Job>    jobs;
+    float               ppm;
+    unsigned int        threads;
+    unsigned int        repeat;
+    unsigned int        warmup;
+    bool                demand;
+    bool                share;
+    bool                runs;
+    bool                arena;
+    Format              format;
+
+    Parameters();
+    bool loadFromArgs(int argc, char *argv[]);
+};
+
+struct Result
+{
+    const Job     * job;
+    size_t          segments;
+    size_t          glyphs;
+    double          seconds;
+    double          loadms;
+    double          p50us;
+    double          p99us;
+    double          allocsPerSeg;
+    double          faceKiB;
+};
+
+// What one thread measures over its passes through the corpus.
+struct Tally
+{
+    std::vector<double> latencies;  // in microseconds
+    size_t              glyphs;
+    unsigned long       allocations;
+
+    Tally() : glyphs(0), allocations(0) {}
+};
+
+
+Parameters::Parameters()
+: dir(GR2BENCH_TESTS_DIR),
+  ppm(12.f),
+  threads(1),
+  repeat(3),
+  warmup(1),
+  demand(false),
+  share(false),
+  runs(false),
+  arena(false),
+  format(TEXT)
+{}
+
+
+void usage(const char * prog)
+{
+    fprintf(stderr,
+        "Usage: %s [options] [font.ttf text.txt]...\n"
+        "Shapes each text, one segment per line, with its font. Without any\n"
+        "pairs given the corpora in the tests directory are used.\n"
+        "Options:\n"
+        "  -dir path     tests directory holding fonts/ and texts/ [%s]\n"
+        "  -rtl          the texts given on the command line are right to left\n"
+        "  -demand       load glyphs on demand rather than preloading the face\n"
+        "  -share        give each thread a face of its own, all sharing their tables\n"
+        "  -runs         shape each space separated run rather than whole lines\n"
+        "  -arena        make the segments in a per thread segment arena\n"
+        "  -threads n    shape on n threads at once. Preloaded faces are shared\n"
+        "                between them, demand loaded ones are not [1]\n"
+        "  -repeat n     timed passes through each corpus [3]\n"
+        "  -warmup n     untimed passes before those [1]\n"
+        "  -ppm n        font size in pixels per em [12]\n"
+        "  -csv, -json   machine readable output\n",
+        prog, GR2BENCH_TESTS_DIR);
+}
+
+
+bool Parameters::loadFromArgs(int argc, char *argv[])
+{
+    std::vector<const char *> files;
+    bool rtl = false;
+
+    for (int a = 1; a < argc; ++a)
+    {
+        const char * const arg = argv[a];
+        const bool hasValue = a + 1 < argc;
+        if (arg[0] != '-')
+            files.push_back(arg);
+        else if (strcmp(arg, "-dir") == 0 && hasValue)
+            dir = argv[++a];
+        else if (strcmp(arg, "-rtl") == 0)
+            rtl = true;
+        else if (strcmp(arg, "-demand") == 0)
+            demand = true;
+        else if (strcmp(arg, "-share") == 0)
+            share = true;
+        else if (strcmp(arg, "-runs") == 0)
+            runs = true;
+        else if (strcmp(arg, "-arena") == 0)
+            arena = true;
+        else if (strcmp(arg, "-threads") == 0 && hasValue)
+            threads = strtoul(argv[++a], NULL, 10);
+        else if (strcmp(arg, "-repeat") == 0 && hasValue)
+            repeat = strtoul(argv[++a], NULL, 10);
+        else if (strcmp(arg, "-warmup") == 0 && hasValue)
+            warmup = strtoul(argv[++a], NULL, 10);
+        else if (strcmp(arg, "-ppm") == 0 && hasValue)
+            ppm = strtof(argv[++a], NULL);
+        else if (strcmp(arg, "-csv") == 0)
+            format = CSV;
+        else if (strcmp(arg, "-json") == 0)
+            format = JSON;
+        else
+        {
+            fprintf(stderr, "Unknown or incomplete option %s\n", arg);
+            return false;
+        }
+    }
+
+    if (files.size() & 1 || !threads || !repeat || ppm <= 0 || (demand && share))
+        return false;
+#if defined GRAPHITE2_NTHREADS
+    if (threads > 1)
+    {
+        fprintf(stderr, "Built without thread support, using one thread\n");
+        threads = 1;
+    }
+#endif
+
+    for (size_t i = 0; i < files.size(); i += 2)
+    {
+        Job j = { files[i], files[i + 1], rtl };
+        jobs.push_back(j);
+    }
+    if (jobs.empty())
+        for (size_t i = 0; i < sizeof default_jobs / sizeof *default_jobs; ++i)
+        {
+            Job j = { dir + "/fonts/" + default_jobs[i].font,
+                      dir + "/texts/" + default_jobs[i].text,
+                      default_jobs[i].rtl };
+            jobs.push_back(j);
+        }
+    return true;
+}
+
+
+// Reads the UTF-8 corpus and splits it into the strings to be shaped.
+bool loadCorpus(const std::string & path, bool runs, std::vector<std::string> & items)
+{
+    FILE * const f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    std::string text;
+    char buf[4096];
+    for (size_t n; (n = fread(buf, 1, sizeof buf, f)) != 0; )
+        text.append(buf, n);
+    fclose(f);
+
+    if (text.compare(0, 3, "\xEF\xBB\xBF") == 0)
+        text.erase(0, 3);
+
+    const char * const seps = runs ? " \r\n" : "\r\n";
+    for (size_t b = text.find_first_not_of(seps); b != std::string::npos; )
+    {
+        const size_t e = text.find_first_of(seps, b);
+        items.push_back(text.substr(b, e == std::string::npos ? e : e - b));
+        b = text.find_first_not_of(seps, e);
+    }
+    return true;
+}
+
+
+void shape(const gr_face * face, const gr_font * font, bool rtl, bool useArena,
+           const std::vector<std::string> & items, unsigned int passes, Tally * tally)
+{
+    gr_shaping_context * const ctx = gr_make_shaping_context();
+    gr_segment_arena * const arena = useArena ? gr_make_segment_arena(0) : NULL;
+    for (unsigned int p = 0; p != passes; ++p)
+        for (size_t i = 0; i != items.size(); ++i)
+        {
+            const char * const text = items[i].data();
+            const size_t nChars = gr_count_unicode_characters(gr_utf8, text, text + items[i].size(), NULL);
+            const timer::time_point start = timer::now();
+            gr_segment * const seg = gr_make_seg_in_arena(arena, ctx, font, face, 0, NULL, gr_utf8, text, nChars, rtl);
+            const size_t glyphs = seg ? gr_seg_n_slots(seg) : 0;
+            const size_t allocs = seg ? gr_seg_n_allocations(seg) : 0;
+            gr_seg_destroy(seg);
+            const timer::time_point end = timer::now();
+            if (!tally) continue;
+            tally->latencies.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+            tally->glyphs += glyphs;
+            tally->allocations += allocs;
+        }
+    gr_segment_arena_destroy(arena);
+    gr_shaping_context_destroy(ctx);
+}
+
+
+bool run(const Parameters & params, const Job & job, Result & res)
+{
+    std::vector<std::string> items;
+    if (!loadCorpus(job.text, params.runs, items))
+    {
+        fprintf(stderr, "Failed to read %s\n", job.text.c_str());
+        return false;
+    }
+
+    // Each thread needs a face of its own unless it is preloaded, since
+    // loading glyphs on demand writes to the face. Shared faces only load
+    // the tables once, as a server making a face per request would.
+    const unsigned int options = params.demand ? gr_face_default
+                               : params.share ? gr_face_shareTables : gr_face_preloadAll;
+    const size_t nFaces = params.demand || params.share ? params.threads : 1;
+    std::vector<gr_face *> faces;
+    std::vector<gr_font *> fonts;
+    const timer::time_point loadStart = timer::now();
+    for (size_t i = 0; i != nFaces; ++i)
+    {
+        gr_face * const face = gr_make_file_face(job.font.c_str(), options);
+        if (!face) break;
+        faces.push_back(face);
+        fonts.push_back(gr_make_font(params.ppm, face));
+    }
+    const timer::time_point loadEnd = timer::now();
+
+    bool ok = faces.size() == nFaces;
+    if (!ok)
+        fprintf(stderr, "Failed to load %s\n", job.font.c_str());
+    else
+    {
+        std::vector<Tally> tallies(params.threads);
+        timer::time_point start, end;
+        if (params.threads == 1)
+        {
+            shape(faces[0], fonts[0], job.rtl, params.arena, items, params.warmup, NULL);
+            start = timer::now();
+            shape(faces[0], fonts[0], job.rtl, params.arena, items, params.repeat, &tallies[0]);
+            end = timer::now();
+        }
+#if !defined GRAPHITE2_NTHREADS
+        else
+        {
+            std::vector<std::thread> workers;
+            for (size_t t = 0; t != params.threads; ++t)
+                workers.push_back(std::thread(shape, faces[t % nFaces], fonts[t % nFaces],
+                                              job.rtl, params.arena, std::cref(items), params.warmup, (Tally *)NULL));
+            for (size_t t = 0; t != workers.size(); ++t)
+                workers[t].join();
+            workers.clear();
+
+            start = timer::now();
+            for (size_t t = 0; t != params.threads; ++t)
+                workers.push_back(std::thread(shape, faces[t % nFaces], fonts[t % nFaces],
+                                              job.rtl, params.arena, std::cref(items), params.repeat, &tallies[t]));
+            for (size_t t = 0; t != workers.size(); ++t)
+                workers[t].join();
+            end = timer::now();
+        }
+#endif
+
+        std::vector<double> latencies;
+        unsigned long allocs = 0;
+        res.glyphs = 0;
+        for (size_t t = 0; t != tallies.size(); ++t)
+        {
+            latencies.insert(latencies.end(), tallies[t].latencies.begin(), tallies[t].latencies.end());
+            res.glyphs += tallies[t].glyphs;
+            allocs += tallies[t].allocations;
+        }
+        res.job = &job;
+        res.segments = latencies.size();
+        res.seconds = std::chrono::duration<double>(end - start).count();
+        res.loadms = std::chrono::duration<double, std::milli>(loadEnd - loadStart).count() / double(nFaces);
+        res.p50us = res.p99us = 0;
+        if (!latencies.empty())
+        {
+            std::sort(latencies.begin(), latencies.end());
+            res.p50us = latencies[(latencies.size() - 1) / 2];
+            res.p99us = latencies[(latencies.size() - 1) * 99 / 100];
+        }
+        res.allocsPerSeg = res.segments ? double(allocs) / double(res.segments) : 0;
+        res.faceKiB = 0;
+        for (size_t i = 0; i != nFaces; ++i)
+            res.faceKiB += double(gr_face_memory_current(faces[i])) / 1024;
+    }
+
+    for (size_t i = 0; i != faces.size(); ++i)
+    {
+        gr_font_destroy(fonts[i]);
+        gr_face_destroy(faces[i]);
+    }
+    return ok;
+}
+
+
+std::string leafName(const std::string & path)
+{
+    const size_t s = path.find_last_of("/\\");
+    return s == std::string::npos ? path : path.substr(s + 1);
+}
+
+
+void report(const Parameters & params, const std::vector<Result> & results)
+{
+    const char * const mode = params.demand ? "demand" : params.share ? "share" : "preload";
+    const char * const unit = params.runs ? "runs" : "lines";
+    const char * const alloc = params.arena ? "arena" : "heap";
+
+    switch (params.format)
+    {
+    case TEXT:
+        printf("%s faces, %s, %s segments, %u thread%s, %u pass%s, %g ppm\n", mode, unit, alloc,
+               params.threads, params.threads == 1 ? "" : "s",
+               params.repeat, params.repeat == 1 ? "" : "es", double(params.ppm));
+        printf("%-26s %-25s %8s %9s %10s %11s %8s %8s %10s %8s %9s\n", "font", "text", "segs",
+               "glyphs", "segs/s", "glyphs/s", "p50 us", "p99 us", "allocs/seg", "load ms", "face KiB");
+        for (size_t i = 0; i != results.size(); ++i)
+        {
+            const Result & r = results[i];
+            printf("%-26s %-25s %8zu %9zu %10.0f %11.0f %8.2f %8.2f %10.1f %8.2f %9.1f\n",
+                   leafName(r.job->font).c_str(), leafName(r.job->text).c_str(),
+                   r.segments, r.glyphs, double(r.segments) / r.seconds, double(r.glyphs) / r.seconds,
+                   r.p50us, r.p99us, r.allocsPerSeg, r.loadms, r.faceKiB);
+        }
+        break;
+    case CSV:
+        printf("font,text,mode,unit,memory,threads,segments,glyphs,seconds,segs_per_s,glyphs_per_s,p50_us,p99_us,allocs_per_seg,load_ms,face_kib\n");
+        for (size_t i = 0; i != results.size(); ++i)
+        {
+            const Result & r = results[i];
+            printf("%s,%s,%s,%s,%s,%u,%zu,%zu,%.6f,%.1f,%.1f,%.3f,%.3f,%.2f,%.3f,%.1f\n",
+                   leafName(r.job->font).c_str(), leafName(r.job->text).c_str(), mode, unit, alloc,
+                   params.threads, r.segments, r.glyphs, r.seconds,
+                   double(r.segments) / r.seconds, double(r.glyphs) / r.seconds,
+                   r.p50us, r.p99us, r.allocsPerSeg, r.loadms, r.faceKiB);
+        }
+        break;
+    case JSON:
+        printf("{\"mode\": \"%s\", \"unit\": \"%s\", \"memory\": \"%s\", \"threads\": %u, \"repeat\": %u, \"ppm\": %g,\n \"results\": [",
+               mode, unit, alloc, params.threads, params.repeat, double(params.ppm));
+        for (size_t i = 0; i != results.size(); ++i)
+        {
+            const Result & r = results[i];
+            printf("%s\n  {\"font\": \"%s\", \"text\": \"%s\", \"segments\": %zu, \"glyphs\": %zu, \"seconds\": %.6f, "
+                   "\"segs_per_s\": %.1f, \"glyphs_per_s\": %.1f, \"p50_us\": %.3f, \"p99_us\": %.3f, "
+                   "\"allocs_per_seg\": %.2f, \"load_ms\": %.3f, \"face_kib\": %.1f}",
+                   i ? "," : "", leafName(r.job->font).c_str(), leafName(r.job->text).c_str(),
+                   r.segments, r.glyphs, r.seconds,
+                   double(r.segments) / r.seconds, double(r.glyphs) / r.seconds,
+                   r.p50us, r.p99us, r.allocsPerSeg, r.loadms, r.faceKiB);
+        }
+        printf("]}\n");
+        break;
+    }
+}
+
+} // namespace
+
+
+int main(int argc, char *argv[])
+{
+    Parameters params;
+    if (!params.loadFromArgs(argc, argv))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<Result> results(params.jobs.size());
+    int status = 0;
+    for (size_t i = 0; i != params.jobs.size(); ++i)
+    {
+        if (!run(params, params.jobs[i], results[i]))
+        {
+            results.resize(i);
+            status = 2;
+            break;
+        }
+    }
+    report(params, results);
+    return status;
+}
@@ -91,6 +91,7 @@ public:
     bool lineEnd;
     bool ws;
     bool rtl;
+    bool fullbidi;
     bool useLineFill;
     bool noprint;
     int useCodes;
@@ -135,6 +136,7 @@ void Parameters::clear()
     lineStart = false;
     lineEnd = false;
     rtl = false;
+    fullbidi = false;
     ws = false;
     useLineFill = false;
     useCodes = 0;
@@ -340,6 +342,11 @@ bool Parameters::loadFromArgs(int argc, char *argv[])
                     option = NONE;
                     rtl = true;
                 }
+                else if (strcmp(argv[a], "-bidi") == 0)
+                {
+                    option = NONE;
+                    fullbidi = true;
+                }
                 else if (strcmp(argv[a], "-ws") == 0)
                 {
                     option = NONE;
@@ -674,7 +681,7 @@ int Parameters::testFileFont() const
                 ui++;
             }
             *ui = 0;
-            pSeg = gr_make_seg(sizedFont, face, 0, features ? featureList : NULL, (gr_encform)codesize, pText16, textSrc.getLength(), rtl ? 1 : 0);
+            pSeg = gr_make_seg(sizedFont, face, 0, features ? featureList : NULL, (gr_encform)codesize, pText16, textSrc.getLength(), (rtl ? 1 : 0) | (fullbidi ? 8 : 0));
         }
         else if (codesize == 1)
         {
@@ -687,12 +694,12 @@ int Parameters::testFileFont() const
                 ui++;
             }
             *ui = 0;
-            pSeg = gr_make_seg(sizedFont, face, 0, features ? featureList : NULL, (gr_encform)codesize, pText8, textSrc.getLength(), rtl ? 1 : 0);
+            pSeg = gr_make_seg(sizedFont, face, 0, features ? featureList : NULL, (gr_encform)codesize, pText8, textSrc.getLength(), (rtl ? 1 : 0) | (fullbidi ? 8 : 0));
             free(pText8);
         }
         else
             pSeg = gr_make_seg(sizedFont, face, 0, features ? featureList : NULL, textSrc.utfEncodingForm(),
-                textSrc.get_utf_buffer_begin(), textSrc.getLength(), rtl ? 1 : 0);
+                textSrc.get_utf_buffer_begin(), textSrc.getLength(), (rtl ? 1 : 0) | (fullbidi ? 8 : 0));
 
         if (pSeg && !noprint)
         {
@@ -785,6 +792,7 @@ int main(int argc, char *argv[])
         //fprintf(stderr,"-ls\tStart of line = true (false)\n");
         //fprintf(stderr,"-le\tEnd of line = true (false)\n");
         fprintf(stderr,"-rtl\tRight to left = true (false)\n");
+        fprintf(stderr,"-bidi\tResolve mixed direction text with the built in bidi algorithm (false)\n");
         fprintf(stderr,"-j percentage\tJustify to percentage of string width\n");
         //fprintf(stderr,"-ws\tAllow trailing whitespace = true (false)\n");
         //fprintf(stderr,"-linefill w\tuse a LineFillSegment of width w (RangeSegment)\n");
@@ -29,8 +29,8 @@
 #include "graphite2/Types.h"
 
 #define GR2_VERSION_MAJOR   1
-#define GR2_VERSION_MINOR   3
-#define GR2_VERSION_BUGFIX  11
+#define GR2_VERSION_MINOR   4
+#define GR2_VERSION_BUGFIX  0
 
 #ifdef __cplusplus
 extern "C"
@@ -63,7 +63,25 @@ enum gr_face_options {
     /** Cache the lookup from code point to glyph ID at construction time */
     gr_face_cacheCmap = 4,
     /** Preload everything */
-    gr_face_preloadAll = gr_face_preloadGlyphs | gr_face_cacheCmap
+    gr_face_preloadAll = gr_face_preloadGlyphs | gr_face_cacheCmap,
+    /** Resolve independent collision ranges of a segment on a pool of worker
+      * threads owned by the face. Results are identical to serial resolution. */
+    gr_face_parallelCollisions = 8,
+    /** Share the loaded tables with every other face made with this option
+      * from the same font, loading them only for the first. Faces are
+      * matched by a hash of the font's tables, or by the identity given to
+      * gr_make_shared_face_with_ops(). Implies gr_face_preloadAll. Without
+      * thread support each face loads tables of its own. */
+    gr_face_shareTables = 16,
+    /** Return as soon as the graphite tables are loaded, with glyphs and the
+      * cmap loaded on demand, and preload those on a background thread, as
+      * gr_face_preloadAll would. The face switches to them once they are
+      * ready, see gr_face_is_preloaded(). Until then, as with any face that
+      * loads on demand, use the face on one thread at a time. The table
+      * functions are not called from the background thread. Without thread
+      * support the preloading is done before the face is returned. Ignored
+      * with gr_face_shareTables. */
+    gr_face_preloadAsync = 32
 };
 
 /** Holds information about a particular Graphite silf table that has been loaded */
@@ -130,6 +148,28 @@ typedef struct gr_face_ops	gr_face_ops;
   */
 GR2_API gr_face* gr_make_face_with_ops(const void* appFaceHandle/*non-NULL*/, const gr_face_ops *face_ops, unsigned int faceOptions);
 
+/** Create a gr_face object that shares its loaded tables, the features,
+  * glyphs, cmap cache and graphite passes, with every other face of the same
+  * font, as gr_face_shareTables does. The tables are kept, process wide, for
+  * as long as any face uses them. Each face still has its own logger, error
+  * state and worker threads.
+  *
+  * @return gr_face or NULL if the font fails to load for some reason.
+  * @param appFaceHandle As for gr_make_face_with_ops().
+  * @param face_ops      As for gr_make_face_with_ops().
+  * @param fontId        Bytes that identify the font, such as a digest of the
+  *                      font file, which the caller guarantees are the same
+  *                      only for the same font data. If NULL the font is
+  *                      identified by a hash of its tables. That hash is not
+  *                      cryptographic, so fonts from parties that must not
+  *                      be able to affect each other's shaping should be
+  *                      given an identity.
+  * @param idLength      The number of bytes in fontId.
+  * @param faceOptions   Bitfield describing various options. See enum gr_face_options for details.
+  */
+GR2_API gr_face* gr_make_shared_face_with_ops(const void* appFaceHandle/*non-NULL*/, const gr_face_ops *face_ops,
+                                              const void *fontId, size_t idLength, unsigned int faceOptions);
+
 /** @deprecated Since v1.2.0 in favour of gr_make_face_with_ops.
   * Create a gr_face object given application information and a getTable function.
   *
@@ -236,6 +276,29 @@ GR2_API const gr_faceinfo *gr_face_info(const gr_face *pFace, gr_uint32 script);
   */
 GR2_API int gr_face_is_char_supported(const gr_face *pFace, gr_uint32 usv, gr_uint32 script);
 
+/** Returns the number of heap bytes currently allocated on behalf of the face.
+  *
+  * This covers the face's own tables and caches, and any fonts and segments
+  * made with it that are still alive, including the allocator's bookkeeping.
+  */
+GR2_API size_t gr_face_memory_current(const gr_face *pFace);
+
+/** Returns the most heap bytes ever allocated on behalf of the face at once.
+  * See gr_face_memory_current for what is counted. */
+GR2_API size_t gr_face_memory_peak(const gr_face *pFace);
+
+/** Returns 1 once the face's glyphs and cmap are all loaded, which a face made
+  * with gr_face_preloadAll is from the start and one made with
+  * gr_face_preloadAsync is once its background thread has finished. Returns
+  * 0 while they are still loaded on demand. */
+GR2_API int gr_face_is_preloaded(const gr_face *pFace);
+
+/** Waits for a face made with gr_face_preloadAsync to finish preloading.
+  *
+  * @return as gr_face_is_preloaded() does, once any preloading is done.
+  */
+GR2_API int gr_face_wait_preloaded(const gr_face *pFace);
+
 #ifndef GRAPHITE2_NFILEFACE
 /** Create gr_face from a font file
   *
@@ -272,6 +335,15 @@ GR2_API gr_font* gr_make_font(float ppm, const gr_face *face);
  */
 typedef float (*gr_advance_fn)(const void* appFontHandle, gr_uint16 glyphid);
 
+/** query function to find the hinted advances of several glyphs at once
+  *
+  * @param appFontHandle is the unique information passed to gr_make_font_with_ops()
+  * @param glyphids are the glyphs to retrieve the hinted advances for.
+  * @param count is the number of glyphs in glyphids.
+  * @param advances receives the advance of glyphids[i] in advances[i].
+ */
+typedef void (*gr_advances_fn)(const void* appFontHandle, const gr_uint16 * glyphids, size_t count, float * advances);
+
 /** struct housing function pointers to manage font hinted metrics for the
   * graphite engine. */
 struct gr_font_ops
@@ -288,6 +360,12 @@ struct gr_font_ops
           * provide without client assistance.  This can be
           * NULL to signify no horizontal hinted metrics are necessary. */
     gr_advance_fn       glyph_advance_y;
+        /** a pointer to a function to retrieve the hinted
+          * advance widths of many glyphs in one call. When set, the
+          * advances a segment needs that are not cached yet are fetched
+          * through this before it is positioned. This can be NULL, in which
+          * case glyph_advance_x is called for one glyph at a time. */
+    gr_advances_fn      glyph_advances_x;
 };
 typedef struct gr_font_ops  gr_font_ops;
 
@@ -378,6 +456,36 @@ GR2_API void* gr_fref_value_label(const gr_feature_ref* pfeatureref, gr_uint16 s
 /** Destroy a previously returned label string **/
 GR2_API void gr_label_destroy(void * label);
 
+/** struct housing function pointers to supply the heap memory graphite
+  * allocates. */
+struct gr_allocator_ops
+{
+        /** size of the structure in bytes to allow for future extensibility */
+    size_t  size;
+        /** returns a block of at least bytes bytes, aligned for any type, or
+          * NULL if that cannot be done. */
+    void *  (*alloc)(void *handle, size_t bytes);
+        /** resizes a block from alloc as realloc would, moving it if need
+          * be. This can be NULL, in which case alloc and free are used. */
+    void *  (*realloc)(void *handle, void *p, size_t old_bytes, size_t new_bytes);
+        /** frees a block from alloc, given the size that it was asked for
+          * with. */
+    void    (*free)(void *handle, void *p, size_t bytes);
+};
+typedef struct gr_allocator_ops gr_allocator_ops;
+
+/** Sets the allocator graphite takes all its heap memory from.
+  *
+  * Every block graphite frees must come from the allocator that is set at
+  * the time, so this may only be called while no faces, fonts, segments or
+  * other graphite objects exist, such as before any other call.
+  *
+  * @return 0 if ops lacks an alloc or free function, else 1.
+  * @param ops      the allocator to use, or NULL for the C library's.
+  * @param handle   passed to each of the functions in ops.
+  */
+GR2_API int gr_set_allocator(const gr_allocator_ops *ops, void *handle);
+
 /** Copies a gr_feature_val **/
 GR2_API gr_feature_val* gr_featureval_clone(const gr_feature_val* pfeatures);
 
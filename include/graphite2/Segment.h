@@ -50,6 +50,13 @@ enum gr_break_weight {
     gr_breakBeforeClip = -40
 };
 
+enum gr_linebreak_mode {
+    /// Fill each line as far as it will go before starting the next
+    gr_linebreakGreedy = 0,
+    /// Choose the breaks that fill all the lines of a paragraph most evenly
+    gr_linebreakTotalFit = 1
+};
+
 enum gr_justFlags {
     /// Indicates that this segment is a complete line
     gr_justCompleteLine = 0,
@@ -174,12 +181,19 @@ enum gr_bidirtl {
     /// this bit should be set unless you know you are passing full paragraphs of text.
     gr_nobidi = 2,
     /// Disable auto mirroring for rtl text
-    gr_nomirror = 4
+    gr_nomirror = 4,
+    /// Resolve embedding levels with the Unicode Bidirectional Algorithm at the
+    /// font's bidi pass, using the font's bidi glyph attribute for character
+    /// classes. Mixed direction text can then be passed as one segment. Ignored
+    /// if gr_nobidi is set or the font has no bidi pass.
+    gr_fullbidi = 8
 };
 
 typedef struct gr_char_info     gr_char_info;
 typedef struct gr_segment       gr_segment;
 typedef struct gr_slot          gr_slot;
+typedef struct gr_shaping_context gr_shaping_context;
+typedef struct gr_segment_arena gr_segment_arena;
 
 /** Returns Unicode character for a charinfo.
   *
@@ -268,6 +282,73 @@ GR2_API size_t gr_count_unicode_characters(enum gr_encform enc, const void* buff
   */
 GR2_API gr_segment* gr_make_seg(const gr_font* font, const gr_face* face, gr_uint32 script, const gr_feature_val* pFeats, enum gr_encform enc, const void* pStart, size_t nChars, int dir);
 
+/** Creates a shaping context that gr_make_seg_with_context can reuse.
+  *
+  * A shaping context holds working storage used while a segment is being
+  * shaped: the pass machinery's slot map, rule buffer and stack, which would
+  * otherwise take several KB of the caller's stack, and the bidi resolver's
+  * buffer, which is allocated once and then reused rather than allocated for
+  * every segment that needs it. The segment's own slots are still allocated
+  * as usual. A context is not thread safe: each thread that shapes text
+  * should have its own.
+  *
+  * @return a shaping context that needs gr_shaping_context_destroy called on it, or
+  *         NULL if there is not enough memory.
+  */
+GR2_API gr_shaping_context* gr_make_shaping_context(void);
+
+/** Destroys a shaping context, freeing its memory.
+  *
+  * Segments made with the context remain valid after it is destroyed.
+  *
+  * @param p The shaping context to destroy. May be NULL.
+  */
+GR2_API void gr_shaping_context_destroy(gr_shaping_context* p);
+
+/** Creates and returns a segment using the working storage of a shaping context.
+  *
+  * Behaves exactly as gr_make_seg. The context is only used for the duration of
+  * the call and must not be in use by another thread at the same time.
+  *
+  * @param ctx The shaping context to use. If NULL this is the same as gr_make_seg.
+  * @see gr_make_seg for the other parameters.
+  */
+GR2_API gr_segment* gr_make_seg_with_context(gr_shaping_context* ctx, const gr_font* font, const gr_face* face, gr_uint32 script, const gr_feature_val* pFeats, enum gr_encform enc, const void* pStart, size_t nChars, int dir);
+
+/** Creates an arena to make segments in.
+  *
+  * A segment made in an arena takes all its memory from it, rather than from
+  * the heap one piece at a time. Once every segment made in the arena has been
+  * destroyed its memory is reused for the next ones, so a caller shaping one
+  * paragraph or line after another rarely allocates at all. An arena is not
+  * thread safe: each thread that shapes text should have its own.
+  *
+  * @return an arena that needs gr_segment_arena_destroy called on it, or NULL
+  *         if there is not enough memory.
+  * @param bytes  How much memory to set aside at first. If 0 a default is
+  *               used. The arena grows as needed in any case.
+  */
+GR2_API gr_segment_arena* gr_make_segment_arena(size_t bytes);
+
+/** Destroys an arena, freeing its memory.
+  *
+  * Every segment made in the arena must have been destroyed first.
+  *
+  * @param p The arena to destroy. May be NULL.
+  */
+GR2_API void gr_segment_arena_destroy(gr_segment_arena* p);
+
+/** Creates and returns a segment whose memory comes from an arena.
+  *
+  * Behaves exactly as gr_make_seg_with_context. The segment is still
+  * destroyed with gr_seg_destroy, before the arena is.
+  *
+  * @param arena The arena to make the segment in. If NULL this is the same
+  *              as gr_make_seg_with_context.
+  * @see gr_make_seg_with_context for the other parameters.
+  */
+GR2_API gr_segment* gr_make_seg_in_arena(gr_segment_arena* arena, gr_shaping_context* ctx, const gr_font* font, const gr_face* face, gr_uint32 script, const gr_feature_val* pFeats, enum gr_encform enc, const void* pStart, size_t nChars, int dir);
+
 /** Destroys a segment, freeing the memory.
   *
   * @param p The segment to destroy
@@ -292,6 +373,19 @@ GR2_API const gr_char_info* gr_seg_cinfo(const gr_segment* pSeg/*not NULL*/, uns
 /** Returns the number of glyph gr_slots in the segment. **/
 GR2_API unsigned int gr_seg_n_slots(const gr_segment* pSeg/*not NULL*/);      //one slot per glyph
 
+/** Returns the number of heap allocations made while creating the segment. **/
+GR2_API size_t gr_seg_n_allocations(const gr_segment* pSeg/*not NULL*/);
+
+/** Returns the number of heap bytes allocated while creating the segment,
+  * whether or not they have been freed since. **/
+GR2_API size_t gr_seg_bytes_allocated(const gr_segment* pSeg/*not NULL*/);
+
+/** Returns the most gr_slots the segment has had in use at once. **/
+GR2_API unsigned int gr_seg_slots_high_water(const gr_segment* pSeg/*not NULL*/);
+
+/** Returns the number of gr_slots the segment has allocated room for. **/
+GR2_API unsigned int gr_seg_slot_pool_size(const gr_segment* pSeg/*not NULL*/);
+
 /** Returns the first gr_slot in the segment.
   *
   * The first slot in a segment has a gr_slot_prev_in_segment() of NULL. Slots are owned
@@ -326,6 +420,46 @@ GR2_API const gr_slot* gr_seg_last_slot(gr_segment* pSeg/*not NULL*/);    //may
   */
 GR2_API float gr_seg_justify(gr_segment* pSeg/*not NULL*/, const gr_slot* pStart/*not NULL*/, const gr_font *pFont, double width, enum gr_justFlags flags, const gr_slot* pFirst, const gr_slot* pLast);
 
+/** Justifies all the lines of a segment in one call
+  *
+  * Gives the same results as calling gr_seg_justify on each line in turn, with pFirst and
+  * pLast NULL, but shares the set up common to all the lines. The lines must already have
+  * been separated with gr_slot_linebreak_before.
+  *
+  * @param pSeg     Pointer to the segment
+  * @param ctx      Shaping context to run the justification passes in, as for
+  *                 gr_make_seg_with_context. May be NULL.
+  * @param pFont    Font to use for positioning
+  * @param numLines Number of lines
+  * @param pStarts  The start of each line's linked list, as passed to gr_seg_justify
+  * @param pWidths  Width to fit each line to. A width < 0. leaves that line at its natural
+  *                 width, as for gr_seg_justify.
+  * @param flags    Indicates line ending types, applied to every line
+  * @param pResults If not NULL, receives the value gr_seg_justify would return for each line
+  */
+GR2_API void gr_seg_justify_lines(gr_segment* pSeg/*not NULL*/, gr_shaping_context* ctx, const gr_font *pFont, size_t numLines, const gr_slot** pStarts, const float* pWidths, enum gr_justFlags flags, float* pResults);
+
+/** Finds where to break a segment into lines no wider than a given width
+  *
+  * Breaks may fall before any slot that allows insertion before it, where the breakweight
+  * between the characters either side is between 1 and maxWeight. Trailing whitespace is
+  * not counted in the width of a line. Where no allowed break gives a line that fits, the
+  * line is left overlong. The segment itself is not changed: pass each line start after
+  * the first to gr_slot_linebreak_before to set the lines up for gr_seg_justify.
+  *
+  * @return the number of lines. This may be more than maxLines, in which case only the
+  *         first maxLines are stored.
+  * @param pSeg     Pointer to the segment
+  * @param width    Width of a line, in the same units as the slot positions
+  * @param maxWeight The weakest break to allow, e.g. gr_breakWord
+  * @param mode     How to choose between the possible sets of breaks
+  * @param maxLines Number of entries in pBreaks and pWidths
+  * @param pBreaks  If not NULL, receives the first slot of each line. The first line always
+  *                 starts with the first slot of the segment.
+  * @param pWidths  If not NULL, receives the natural width of each line
+  */
+GR2_API size_t gr_seg_break_lines(const gr_segment* pSeg/*not NULL*/, float width, int maxWeight, enum gr_linebreak_mode mode, size_t maxLines, const gr_slot** pBreaks, float* pWidths);
+
 /** Returns the next slot along in the segment.
   *
   * Slots are held in a linked list. This returns the next in the linked list. The slot
@@ -0,0 +1,639 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#include "inc/Main.h"
+#include "inc/Segment.h"
+#include "inc/ShapingContext.h"
+#include "inc/Slot.h"
+
+using namespace graphite2;
+
+namespace
+{
+
+// The values of the font's bidi glyph attribute
+enum DirCode
+{
+    ON = 0, L = 1, R = 2, AL = 3, EN = 4, ES = 5, ET = 6, AN = 7, CS = 8, WS = 9, BN = 10,
+    LRO = 11, RLO = 12, LRE = 13, RLE = 14, PDF = 15, NSM = 16,
+    LRI = 17, RLI = 18, FSI = 19, PDI = 20, OPP = 21, CPP = 22,
+    NUM_DIRCODES
+};
+
+#define DIRBIT(c) (1u << (c))
+
+const uint32
+    OPENERS     = DIRBIT(LRO) | DIRBIT(RLO) | DIRBIT(LRE) | DIRBIT(RLE)
+                | DIRBIT(LRI) | DIRBIT(RLI) | DIRBIT(FSI),
+    ISOLATES    = DIRBIT(LRI) | DIRBIT(RLI) | DIRBIT(FSI),
+    REMOVED     = DIRBIT(LRO) | DIRBIT(RLO) | DIRBIT(LRE) | DIRBIT(RLE) | DIRBIT(PDF) | DIRBIT(BN),
+    NEUTRALS    = DIRBIT(ON) | DIRBIT(WS) | ISOLATES | DIRBIT(PDI) | DIRBIT(OPP) | DIRBIT(CPP),
+    TRAILING    = DIRBIT(WS) | ISOLATES | DIRBIT(PDI) | REMOVED,
+    // Paragraphs whose classes avoid these resolve every slot to the paragraph level.
+    NOT_ALL_LTR = OPENERS | DIRBIT(R) | DIRBIT(AL) | DIRBIT(AN),
+    NOT_ALL_RTL = OPENERS | DIRBIT(L) | DIRBIT(EN) | DIRBIT(AN);
+
+const int MAX_DEPTH = 125,
+          MAX_BRACKETS = 63;
+
+inline bool is(uint8 c, uint32 set) { return (DIRBIT(c) & set) != 0; }
+
+inline uint8 dirCode(int8 c) { return c < 0 || c >= NUM_DIRCODES ? uint8(ON) : uint8(c); }
+
+// The direction a class contributes to neutral and bracket resolution
+inline uint8 strongDir(uint8 c)
+{
+    switch (c)
+    {
+    case L:     return L;
+    case R: case AL: case EN: case AN:  return R;
+    default:    return ON;
+    }
+}
+
+inline uint8 nextOdd(uint8 l)  { return uint8((l + 1) | 1); }
+inline uint8 nextEven(uint8 l) { return uint8((l + 2) & ~1); }
+
+
+// Resolves embedding levels over a paragraph's slots in logical order
+struct Resolver
+{
+    Segment   & seg;
+    Slot     ** slot;
+    int       * match,      // matching isolate initiator or PDI, -1 if none
+              * pos,        // index into kept, -1 if removed by X9
+              * kept,       // the slots X9 keeps
+              * runEnd,     // index into kept past the end of each slot's level run
+              * seq,        // the current isolating run sequence
+              * pair;       // index in seq of the closing bracket for an opening bracket
+    uint8     * cls,        // resolved class
+              * ocls,       // original class
+              * level;
+    size_t      n,
+                nkept;
+    uint32      mask;       // the classes present in the paragraph
+    uint8       paralevel,
+                aMirror;
+
+    Resolver(Segment & s) : seg(s) {}
+
+    void matchIsolates();
+    uint8 firstStrong(size_t i, size_t end) const;
+    void explicitLevels();
+    void isolatingRuns();
+    void resolveSequence(size_t k, uint8 sos, uint8 eos);
+    void implicitLevels();
+    void weakTypes(size_t k, uint8 sos);
+    void pairedBrackets(size_t k, uint8 sos);
+    void neutralTypes(size_t k, uint8 sos, uint8 eos);
+    void removedAndTrailing();
+    bool brackets(size_t open, size_t close) const;
+};
+
+
+void Resolver::matchIsolates()
+{
+    size_t sp = 0;
+    for (size_t i = 0; i != n; ++i)
+    {
+        match[i] = -1;
+        if (is(ocls[i], ISOLATES))
+            seq[sp++] = int(i);
+        else if (ocls[i] == PDI && sp)
+        {
+            const int j = seq[--sp];
+            match[j] = int(i);
+            match[i] = j;
+        }
+    }
+}
+
+// P2: skips over isolates and stops at an unmatched one
+uint8 Resolver::firstStrong(size_t i, size_t end) const
+{
+    for (; i < end; ++i)
+    {
+        const uint8 c = ocls[i];
+        if (c == L)                 return L;
+        if (c == R || c == AL)      return R;
+        if (is(c, ISOLATES))
+        {
+            if (match[i] < 0)   break;
+            i = match[i];
+        }
+    }
+    return ON;
+}
+
+// X1 - X8
+void Resolver::explicitLevels()
+{
+    struct Status { uint8 level, override; bool isolate; } stack[MAX_DEPTH + 2];
+    int sp = 0,
+        overflowIsolates = 0,
+        overflowEmbeddings = 0,
+        validIsolates = 0;
+    stack[0].level = paralevel;
+    stack[0].override = ON;
+    stack[0].isolate = false;
+
+    for (size_t i = 0; i != n; ++i)
+    {
+        const uint8 c = cls[i];
+        uint8 nl;
+        level[i] = stack[sp].level;
+        switch (c)
+        {
+        case RLE: case LRE: case RLO: case LRO:
+            nl = (c == RLE || c == RLO) ? nextOdd(stack[sp].level) : nextEven(stack[sp].level);
+            if (nl <= MAX_DEPTH && !overflowIsolates && !overflowEmbeddings)
+            {
+                ++sp;
+                stack[sp].level = nl;
+                stack[sp].override = c == RLO ? R : (c == LRO ? L : ON);
+                stack[sp].isolate = false;
+            }
+            else if (!overflowIsolates)
+                ++overflowEmbeddings;
+            break;
+        case RLI: case LRI: case FSI:
+            if (stack[sp].override != ON)
+                cls[i] = stack[sp].override;
+            if (c == RLI || (c == FSI && firstStrong(i + 1, match[i] < 0 ? n : size_t(match[i])) == R))
+                nl = nextOdd(stack[sp].level);
+            else
+                nl = nextEven(stack[sp].level);
+            if (nl <= MAX_DEPTH && !overflowIsolates && !overflowEmbeddings)
+            {
+                ++validIsolates;
+                ++sp;
+                stack[sp].level = nl;
+                stack[sp].override = ON;
+                stack[sp].isolate = true;
+            }
+            else
+                ++overflowIsolates;
+            break;
+        case PDI:
+            if (overflowIsolates)
+                --overflowIsolates;
+            else if (validIsolates)
+            {
+                overflowEmbeddings = 0;
+                while (!stack[sp].isolate)
+                    --sp;
+                --sp;
+                --validIsolates;
+            }
+            level[i] = stack[sp].level;
+            if (stack[sp].override != ON)
+                cls[i] = stack[sp].override;
+            break;
+        case PDF:
+            if (overflowIsolates)
+                break;
+            if (overflowEmbeddings)
+                --overflowEmbeddings;
+            else if (!stack[sp].isolate && sp > 0)
+                --sp;
+            break;
+        case BN:
+            break;
+        default:
+            if (stack[sp].override != ON)
+                cls[i] = stack[sp].override;
+            break;
+        }
+    }
+}
+
+// X9 - X10: finds the level runs once, then resolves each isolating run
+// sequence they chain into. The runs, and the levels either side of them that
+// give sos and eos, all come from the explicit levels, which stay untouched
+// until every sequence has been resolved.
+void Resolver::isolatingRuns()
+{
+    nkept = 0;
+    for (size_t i = 0; i != n; ++i)
+    {
+        if (is(ocls[i], REMOVED))
+            pos[i] = -1;
+        else
+        {
+            pos[i] = int(nkept);
+            kept[nkept++] = int(i);
+        }
+    }
+
+    for (size_t p = 0; p < nkept; )
+    {
+        size_t q = p + 1;
+        while (q < nkept && level[kept[q]] == level[kept[p]])
+            ++q;
+        for (; p != q; ++p)
+            runEnd[p] = int(q);
+    }
+
+    for (size_t p = 0; p < nkept; p = runEnd[p])
+    {
+        const int first = kept[p];
+        // A run starting with a matched PDI continues the sequence of its initiator
+        if (ocls[first] == PDI && match[first] >= 0)
+            continue;
+
+        size_t k = 0;
+        for (size_t r = p; ; )
+        {
+            for (const size_t e = runEnd[r]; r != e; ++r)
+                seq[k++] = kept[r];
+            const int last = seq[k - 1];
+            if (!is(ocls[last], ISOLATES) || match[last] < 0)
+                break;
+            r = pos[match[last]];
+        }
+
+        const int last = seq[k - 1];
+        const uint8 l = level[first],
+                    before = p ? level[kept[p - 1]] : paralevel,
+                    after = (is(ocls[last], ISOLATES) || size_t(pos[last]) + 1 >= nkept)
+                                ? paralevel : level[kept[pos[last] + 1]];
+        resolveSequence(k, (max(before, l) & 1) ? R : L, (max(after, l) & 1) ? R : L);
+    }
+    implicitLevels();
+}
+
+void Resolver::resolveSequence(size_t k, uint8 sos, uint8 eos)
+{
+    weakTypes(k, sos);
+    if ((mask & DIRBIT(OPP)) && (mask & DIRBIT(CPP)))
+        pairedBrackets(k, sos);
+    neutralTypes(k, sos, eos);
+}
+
+// I1 - I2
+void Resolver::implicitLevels()
+{
+    for (size_t p = 0; p != nkept; ++p)
+    {
+        const uint8 c = cls[kept[p]];
+        uint8 & l = level[kept[p]];
+        if (l & 1)
+            l += (c == L || c == EN || c == AN);
+        else if (c == R)
+            l += 1;
+        else if (c == AN || c == EN)
+            l += 2;
+    }
+}
+
+// W1 - W7, each skipped when the paragraph has nothing for it to act on.
+void Resolver::weakTypes(size_t k, uint8 sos)
+{
+    if (mask & DIRBIT(NSM))
+    {
+        for (size_t j = 0; j != k; ++j)
+        {
+            if (cls[seq[j]] != NSM) continue;
+            if (!j)
+                cls[seq[j]] = sos;
+            else
+            {
+                const uint8 p = cls[seq[j - 1]];
+                // Marks on brackets are settled with their bracket in N0
+                cls[seq[j]] = (is(ocls[seq[j - 1]], ISOLATES | DIRBIT(PDI)) || p == OPP || p == CPP) ? uint8(ON) : p;
+            }
+        }
+    }
+
+    if (mask & DIRBIT(AL))
+    {
+        uint8 strong = sos;
+        for (size_t j = 0; j != k; ++j)
+        {
+            uint8 & c = cls[seq[j]];
+            if (c == L || c == R)
+                strong = c;
+            else if (c == AL)
+            {
+                strong = AL;
+                c = R;
+            }
+            else if (c == EN && strong == AL)
+                c = AN;
+        }
+    }
+
+    if (mask & (DIRBIT(ES) | DIRBIT(CS)))
+    {
+        for (size_t j = 1; j + 1 < k; ++j)
+        {
+            uint8 & c = cls[seq[j]];
+            if (c != ES && c != CS) continue;
+            const uint8 p = cls[seq[j - 1]], q = cls[seq[j + 1]];
+            if (p == EN && q == EN)
+                c = EN;
+            else if (c == CS && p == AN && q == AN)
+                c = AN;
+        }
+    }
+
+    if ((mask & DIRBIT(ET)) && (mask & DIRBIT(EN)))
+    {
+        for (size_t j = 0; j != k; )
+        {
+            if (cls[seq[j]] != ET) { ++j; continue; }
+            size_t e = j;
+            while (e != k && cls[seq[e]] == ET)
+                ++e;
+            if ((j && cls[seq[j - 1]] == EN) || (e != k && cls[seq[e]] == EN))
+                for (; j != e; ++j)
+                    cls[seq[j]] = EN;
+            j = e;
+        }
+    }
+
+    if (mask & (DIRBIT(ES) | DIRBIT(ET) | DIRBIT(CS)))
+    {
+        for (size_t j = 0; j != k; ++j)
+        {
+            uint8 & c = cls[seq[j]];
+            if (c == ES || c == ET || c == CS)
+                c = ON;
+        }
+    }
+
+    if (mask & DIRBIT(EN))
+    {
+        uint8 strong = sos;
+        for (size_t j = 0; j != k; ++j)
+        {
+            uint8 & c = cls[seq[j]];
+            if (c == L || c == R)
+                strong = c;
+            else if (c == EN && strong == L)
+                c = L;
+        }
+    }
+}
+
+// Without a mirror attribute any closing bracket closes the innermost opening one.
+bool Resolver::brackets(size_t open, size_t close) const
+{
+    if (!aMirror) return true;
+    const uint16 g = seg.glyphAttr(slot[open]->gid(), aMirror);
+    return !g || g == slot[close]->gid();
+}
+
+// BD16, N0
+void Resolver::pairedBrackets(size_t k, uint8 sos)
+{
+    int stack[MAX_BRACKETS];
+    int sp = 0;
+    bool any = false;
+    for (size_t j = 0; j != k; ++j)
+        pair[j] = -1;
+    for (size_t j = 0; j != k; ++j)
+    {
+        const uint8 c = cls[seq[j]];
+        if (c == OPP)
+        {
+            if (sp == MAX_BRACKETS) break;
+            stack[sp++] = int(j);
+        }
+        else if (c == CPP)
+        {
+            for (int s = sp; s-- > 0; )
+            {
+                if (brackets(seq[stack[s]], seq[j]))
+                {
+                    pair[stack[s]] = int(j);
+                    sp = s;
+                    any = true;
+                    break;
+                }
+            }
+        }
+    }
+    if (!any) return;
+
+    const uint8 e = (level[seq[0]] & 1) ? R : L,
+                o = e == L ? R : L;
+    for (size_t j = 0; j != k; ++j)
+    {
+        if (cls[seq[j]] != OPP || pair[j] < 0) continue;
+        const size_t close = size_t(pair[j]);
+        bool embedding = false, opposite = false;
+        for (size_t m = j + 1; m != close && !embedding; ++m)
+        {
+            const uint8 d = strongDir(cls[seq[m]]);
+            embedding = d == e;
+            opposite |= d == o;
+        }
+
+        uint8 d = ON;
+        if (embedding)
+            d = e;
+        else if (opposite)
+        {
+            uint8 context = sos;
+            for (size_t m = j; m-- > 0; )
+                if ((context = strongDir(cls[seq[m]])) != ON) break;
+            if (context == ON) context = sos;
+            d = context == o ? o : e;
+        }
+        if (d == ON) continue;
+
+        cls[seq[j]] = cls[seq[close]] = d;
+        for (size_t m = j + 1; m != k && ocls[seq[m]] == NSM; ++m)
+            cls[seq[m]] = d;
+        for (size_t m = close + 1; m != k && ocls[seq[m]] == NSM; ++m)
+            cls[seq[m]] = d;
+    }
+}
+
+// N1 - N2
+void Resolver::neutralTypes(size_t k, uint8 sos, uint8 eos)
+{
+    const uint8 e = (level[seq[0]] & 1) ? R : L;
+    for (size_t j = 0; j != k; )
+    {
+        if (!is(cls[seq[j]], NEUTRALS)) { ++j; continue; }
+        size_t end = j;
+        while (end != k && is(cls[seq[end]], NEUTRALS))
+            ++end;
+        const uint8 before = j ? strongDir(cls[seq[j - 1]]) : sos,
+                    after = end != k ? strongDir(cls[seq[end]]) : eos,
+                    d = before == after ? before : e;
+        for (; j != end; ++j)
+            cls[seq[j]] = d;
+    }
+}
+
+// X9 removed slots follow the level before them, or the one after them at the
+// start, so they never break a run; L1 resets trailing whitespace and isolates.
+void Resolver::removedAndTrailing()
+{
+    uint8 prev = nkept ? level[kept[0]] : paralevel;
+    for (size_t i = 0; i != n; ++i)
+    {
+        if (pos[i] < 0)
+            level[i] = prev;
+        else
+            prev = level[i];
+    }
+    for (size_t i = n; i-- > 0 && is(ocls[i], TRAILING); )
+        level[i] = paralevel;
+}
+
+} // namespace
+
+
+// Resolves the paragraph's embedding levels from each slot's bidi class, mirrors
+// the odd level slots and reorders the slots into the visual order expected by
+// the passes that follow, which is right to left when the silf table is rtl.
+void Segment::bidiPass(int paradir, uint8 aMirror)
+{
+    if (m_dir & 64)
+        reverseSlots();             // back to logical order
+
+    size_t n = 0;
+    uint32 mask = 0;
+    for (Slot *s = m_first; s; s = s->next(), ++n)
+        mask |= DIRBIT(dirCode(getSlotBidiClass(s)));
+    if (!n) return;
+
+    const uint8 paralevel = paradir & 1;
+    const bool rtl = m_silf->dir() & 1;
+    const size_t bytes = n * (sizeof(Slot *) + 6 * sizeof(int) + 3);
+    byte * scratch = 0;
+    if (mask & (paralevel ? NOT_ALL_RTL : NOT_ALL_LTR))
+        scratch = m_context ? m_context->scratch(bytes) : gralloc<byte>(bytes);
+    if (!scratch)
+    {
+        // A single level paragraph only needs the direction of the slot stream fixing up.
+        for (Slot *s = m_first; s; s = s->next())
+        {
+            s->setBidiLevel(paralevel);
+            uint16 g;
+            if (paralevel && aMirror && (g = glyphAttr(s->gid(), aMirror)) != 0
+                    && (!(m_dir & 4) || !glyphAttr(s->gid(), aMirror + 1)))
+                s->setGlyph(this, g);
+        }
+        if (currdir() != rtl)
+            reverseSlots();
+        return;
+    }
+
+    Resolver r(*this);
+    r.slot   = reinterpret_cast<Slot **>(scratch);
+    r.match  = reinterpret_cast<int *>(r.slot + n);
+    r.pos    = r.match + n;
+    r.kept   = r.pos + n;
+    r.runEnd = r.kept + n;
+    r.seq    = r.runEnd + n;
+    r.pair   = r.seq + n;
+    r.cls    = reinterpret_cast<uint8 *>(r.pair + n);
+    r.ocls   = r.cls + n;
+    r.level  = r.ocls + n;
+    r.n = n;
+    r.mask = mask;
+    r.paralevel = paralevel;
+    r.aMirror = aMirror;
+
+    size_t i = 0;
+    for (Slot *s = m_first; s; s = s->next(), ++i)
+    {
+        r.slot[i] = s;
+        r.cls[i] = r.ocls[i] = dirCode(getSlotBidiClass(s));
+    }
+    if (mask & ISOLATES)
+        r.matchIsolates();
+    else
+        for (i = 0; i != n; ++i) r.match[i] = -1;
+    r.explicitLevels();
+    r.isolatingRuns();
+    r.removedAndTrailing();
+
+    // L2 works on units of a base and the marks that follow it, so marks stay
+    // after their base whatever the direction.
+    int * const start = r.kept, * const order = r.seq;
+    uint8 * const ulevel = r.cls;
+    uint8 maxlevel = 0, minodd = MAX_DEPTH + 2;
+    size_t units = 0;
+    for (i = 0; i != n; ++i)
+    {
+        const uint8 l = r.level[i];
+        r.slot[i]->setBidiLevel(l);
+        if ((l & 1) && aMirror)
+        {
+            const uint16 g = glyphAttr(r.slot[i]->gid(), aMirror);
+            if (g && (!(m_dir & 4) || !glyphAttr(r.slot[i]->gid(), aMirror + 1)))
+                r.slot[i]->setGlyph(this, g);
+        }
+        if (i && r.ocls[i] == NSM) continue;
+        start[units] = int(i);
+        order[units] = int(units);
+        ulevel[units++] = l;
+        if (l > maxlevel)               maxlevel = l;
+        if ((l & 1) && l < minodd)      minodd = l;
+    }
+    for (uint8 l = maxlevel; l >= minodd; --l)
+    {
+        for (size_t j = 0; j != units; )
+        {
+            if (ulevel[order[j]] < l) { ++j; continue; }
+            size_t e = j;
+            while (e != units && ulevel[order[e]] >= l)
+                ++e;
+            for (size_t a = j, b = e; a + 1 < b; ++a, --b)
+            {
+                const int t = order[a];
+                order[a] = order[b - 1];
+                order[b - 1] = t;
+            }
+            j = e;
+        }
+    }
+
+    Slot * prev = 0;
+    for (size_t j = 0; j != units; ++j)
+    {
+        const int u = order[rtl ? units - 1 - j : j];
+        const size_t end = size_t(u) + 1 < units ? size_t(start[u + 1]) : n;
+        for (i = start[u]; i != end; ++i)
+        {
+            Slot * const s = r.slot[i];
+            s->prev(prev);
+            if (prev)   prev->next(s);
+            else        m_first = s;
+            prev = s;
+        }
+    }
+    prev->next(0);
+    m_last = prev;
+    m_dir = int8((m_dir & ~64) | ((rtl ^ (m_dir & 1)) << 6));
+    if (!m_context) grfree(scratch);
+}
@@ -91,8 +91,20 @@ CachedCmap::CachedCmap(const Face & face)
     const Face::Table cmap(face, Tag::cmap);
     if (!cmap)  return;
 
-    const void * bmp_cmap = bmp_subtable(cmap);
-    const void * smp_cmap = smp_subtable(cmap);
+    cache(bmp_subtable(cmap), smp_subtable(cmap));
+}
+
+CachedCmap::CachedCmap(const DirectCmap & direct)
+: m_isBmpOnly(true),
+  m_blocks(0)
+{
+    if (!direct._cmap)  return;
+
+    cache(direct._bmp, direct._smp);
+}
+
+void CachedCmap::cache(const void * bmp_cmap, const void * smp_cmap)
+{
     m_isBmpOnly = !smp_cmap;
 
     m_blocks = grzeroalloc<uint16 *>(m_isBmpOnly ? 0x100 : 0x1100);
@@ -114,8 +126,8 @@ CachedCmap::~CachedCmap() throw()
     if (!m_blocks) return;
     unsigned int numBlocks = (m_isBmpOnly)? 0x100 : 0x1100;
     for (unsigned int i = 0; i < numBlocks; i++)
-        free(m_blocks[i]);
-    free(m_blocks);
+        grfree(m_blocks[i]);
+    grfree(m_blocks);
 }
 
 uint16 CachedCmap::operator [] (const uint32 usv) const throw()
@@ -56,12 +56,14 @@ using namespace vm;
 
 namespace {
 
+// While a program is being decoded each instruction holds just its opcode,
+// until we know which dispatch table it can be bound to.
+inline instr as_instr(const opcode opc)     { return reinterpret_cast<instr>(size_t(opc)); }
+inline opcode as_opcode(const instr i)      { return opcode(reinterpret_cast<size_t>(i)); }
+
 inline bool is_return(const instr i) {
-    const opcode_t * opmap = Machine::getOpcodeTable();
-    const instr pop_ret  = *opmap[POP_RET].impl,
-                ret_zero = *opmap[RET_ZERO].impl,
-                ret_true = *opmap[RET_TRUE].impl;
-    return i == pop_ret || i == ret_zero || i == ret_true;
+    const opcode opc = as_opcode(i);
+    return opc == POP_RET || opc == RET_ZERO || opc == RET_TRUE || opc == RET_BYTE;
 }
 
 struct context
@@ -88,6 +90,7 @@ public:
     bool        load(const byte * bc_begin, const byte * bc_end);
     void        apply_analysis(instr * const code, instr * code_end);
     byte        max_ref() { return _max_ref; }
+    bool        stack_bounded() const throw();
     int         out_index() const { return _out_index; }
 
 private:
@@ -110,8 +113,13 @@ private:
     byte              * _data;
     limits            & _max;
     enum passtype       _passtype;
-    int                 _stack_depth;
-    bool                _in_ctxt_item;
+    int                 _stack_depth,
+                        _max_depth,     // deepest the stack gets
+                        _stack_low,     // shallowest the stack can be when some slot is missing
+                        _min_low;
+    bool                _in_ctxt_item,
+                        _unbalanced,    // a context item leaves other than one value
+                        _pushed_byte;   // the last instruction emitted was a PUSH_BYTE
     int16               _slotref;
     context             _contexts[NUMCONTEXTS];
     byte                _max_ref;
@@ -135,7 +143,12 @@ inline Machine::Code::decoder::decoder(limits & lims, Code &code, enum passtype
   _out_length(code._constraint ? 1 : lims.rule_length),
   _instr(code._code), _data(code._data), _max(lims), _passtype(pt),
   _stack_depth(0),
+  _max_depth(0),
+  _stack_low(0),
+  _min_low(0),
   _in_ctxt_item(false),
+  _unbalanced(false),
+  _pushed_byte(false),
   _slotref(0),
   _max_ref(0)
 { }
@@ -163,7 +176,7 @@ Machine::Code::Code(bool is_constraint, const byte * bytecode_begin, const byte
     // Allocate code and data target buffers, these sizes are a worst case
     // estimate.  Once we know their real sizes the we'll shrink them.
     if (_out)   _code = reinterpret_cast<instr *>(*_out);
-    else        _code = static_cast<instr *>(malloc(estimateCodeDataOut(bytecode_end-bytecode_begin, 1, is_constraint ? 0 : rule_length)));
+    else        _code = static_cast<instr *>(grmalloc(estimateCodeDataOut(bytecode_end-bytecode_begin, 1, is_constraint ? 0 : rule_length)));
     _data = reinterpret_cast<byte *>(_code + (bytecode_end - bytecode_begin));
 
     if (!_code || !_data) {
@@ -209,6 +222,14 @@ Machine::Code::Code(bool is_constraint, const byte * bytecode_begin, const byte
     dec.apply_analysis(_code, _code + _instr_count);
     _max_ref = dec.max_ref();
 
+    // Programs that cannot leave the stack bounds can skip checking them
+    // after every instruction.
+    _verified = dec.stack_bounded();
+    if (_verified)
+        op_to_fn = Machine::getOpcodeTable(false);
+    for (instr * ip = _code, * const end = _code + _instr_count; ip != end; ++ip)
+        *ip = op_to_fn[as_opcode(*ip)].impl[_constraint];
+
     // Now we know exactly how much code and data the program really needs
     // realloc the buffers to exactly the right size so we don't waste any
     // memory.
@@ -221,8 +242,8 @@ Machine::Code::Code(bool is_constraint, const byte * bytecode_begin, const byte
     else
     {
       instr * const old_code = _code;
-      _code = static_cast<instr *>(realloc(_code, total_sz));
-      if (!_code) free(old_code);
+      _code = static_cast<instr *>(grrealloc(_code, total_sz));
+      if (!_code) grfree(old_code);
     }
    _data = reinterpret_cast<byte *>(_code + (_instr_count+1));
 
@@ -275,6 +296,7 @@ opcode Machine::Code::decoder::fetch_opcode(const byte * bc)
     // Do some basic sanity checks based on what we know about the opcode
     if (!validate_opcode(opc, bc))  return MAX_OPCODE;
 
+    const int depth = _stack_depth;
     // And check its arguments as far as possible
     switch (opcode(opc))
     {
@@ -475,6 +497,28 @@ opcode Machine::Code::decoder::fetch_opcode(const byte * bc)
             break;
     }
 
+    // Slot based pushes, and set_feat's pop, only happen if the slot exists.
+    _stack_low += _stack_depth - depth;
+    switch (opcode(opc))
+    {
+        case PUSH_SLOT_ATTR :
+        case PUSH_GLYPH_ATTR_OBS :
+        case PUSH_GLYPH_METRIC :
+        case PUSH_FEAT :
+        case PUSH_ATT_TO_GATTR_OBS :
+        case PUSH_ATT_TO_GLYPH_METRIC :
+        case PUSH_ISLOT_ATTR :
+        case PUSH_GLYPH_ATTR :
+        case PUSH_ATT_TO_GLYPH_ATTR :
+        case SET_FEAT :
+            --_stack_low;
+            break;
+        default:
+            break;
+    }
+    if (_stack_depth > _max_depth)  _max_depth = _stack_depth;
+    if (_stack_low < _min_low)      _min_low = _stack_low;
+
     return bool(_code) ? opcode(opc) : MAX_OPCODE;
 }
 
@@ -546,20 +590,56 @@ void Machine::Code::decoder::analyse_opcode(const opcode opc, const int8  * arg)
 }
 
 
+namespace {
+
+// The private opcode doing the work of a PUSH_BYTE followed by opc.
+opcode byte_operand_form(opcode opc)
+{
+    switch (opc)
+    {
+        case POP_RET :          return RET_BYTE;
+        case ADD :              return ADD_BYTE;
+        case SUB :              return SUB_BYTE;
+        case EQUAL :            return EQUAL_BYTE;
+        case NOT_EQ :           return NOT_EQ_BYTE;
+        case LESS :             return LESS_BYTE;
+        case GTR :              return GTR_BYTE;
+        case LESS_EQ :          return LESS_EQ_BYTE;
+        case GTR_EQ :           return GTR_EQ_BYTE;
+        case ATTR_SET :         return ATTR_SET_BYTE;
+        case ATTR_SET_SLOT :    return ATTR_SET_SLOT_BYTE;
+        case IATTR_SET :        return IATTR_SET_BYTE;
+        default:                return opc;
+    }
+}
+
+}
+
 bool Machine::Code::decoder::emit_opcode(opcode opc, const byte * & bc)
 {
     const opcode_t * op_to_fn = Machine::getOpcodeTable();
-    const opcode_t & op       = op_to_fn[opc];
-    if (op.impl[_code._constraint] == 0)
+    const opcode_t * op       = op_to_fn + opc;
+    if (op->impl[_code._constraint] == 0)
     {
         failure(unimplemented_opcode_used);
         return false;
     }
 
-    const size_t     param_sz = op.param_sz == VARARGS ? bc[0] + 1 : op.param_sz;
+    const size_t     param_sz = op->param_sz == VARARGS ? bc[0] + 1 : op->param_sz;
+
+    // Fold the value a PUSH_BYTE just pushed into the instruction using it,
+    // leaving its byte in the data as the new instruction's first parameter.
+    const opcode fused = _pushed_byte ? byte_operand_form(opc) : opc;
+    if (fused != opc && op_to_fn[fused].impl[_code._constraint])
+    {
+        op = op_to_fn + fused;
+        --_instr;
+        --_code._instr_count;
+    }
+    _pushed_byte = opc == PUSH_BYTE;
 
     // Add this instruction
-    *_instr++ = op.impl[_code._constraint];
+    *_instr++ = as_instr(opcode(op - op_to_fn));
     ++_code._instr_count;
 
     // Grab the parameters
@@ -581,22 +661,32 @@ bool Machine::Code::decoder::emit_opcode(opcode opc, const byte * & bc)
         _out_length = _max.rule_length;
 
         const size_t ctxt_start = _code._instr_count;
+        const int depth = _stack_depth,
+                  low = _stack_low;
         byte & instr_skip = _data[-1];
         byte & data_skip  = *_data++;
         ++_code._data_size;
-        const byte *curr_end = _max.bytecode;
+        const byte *curr_end = _max.bytecode,
+                   *data_start = _data;
 
         if (load(bc, bc + instr_skip))
         {
             bc += instr_skip;
-            data_skip  = instr_skip - byte(_code._instr_count - ctxt_start);
-            instr_skip =  byte(_code._instr_count - ctxt_start);
+            data_skip  = byte(_data - data_start);
+            instr_skip = byte(_code._instr_count - ctxt_start);
+            // Skipping the item must land on the instruction after it, so
+            // nothing may be folded across its end.
+            _pushed_byte = false;
             _max.bytecode = curr_end;
 
             _out_length = 1;
             _out_index = 0;
             _slotref = 0;
             _in_ctxt_item = false;
+
+            // Skipping the item pushes true in place of its result.
+            if (_stack_depth != depth + 1)  _unbalanced = true;
+            if (low + 1 < _stack_low)       _stack_low = low + 1;
         }
         else
         {
@@ -616,7 +706,7 @@ void Machine::Code::decoder::apply_analysis(instr * const code, instr * code_end
     int tempcount = 0;
     if (_code._constraint) return;
 
-    const instr temp_copy = Machine::getOpcodeTable()[TEMP_COPY].impl[0];
+    const instr temp_copy = as_instr(TEMP_COPY);
     for (const context * c = _contexts, * const ce = c + _slotref; c < ce; ++c)
     {
         if (!c->flags.referenced || !c->flags.changed) continue;
@@ -633,6 +723,17 @@ void Machine::Code::decoder::apply_analysis(instr * const code, instr * code_end
 }
 
 
+// The depths reached must neither trip the checks every instruction makes
+// nor take the stack pointer outside the guard area.
+inline
+bool Machine::Code::decoder::stack_bounded() const throw()
+{
+    return !_unbalanced
+        && _max_depth < int(Machine::STACK_MAX)
+        && _min_low >= -int(Machine::STACK_GUARD);
+}
+
+
 inline
 bool Machine::Code::decoder::validate_opcode(const byte opc, const byte * const bc)
 {
@@ -728,7 +829,7 @@ void Machine::Code::decoder::set_changed(int index) throw() {
 void Machine::Code::release_buffers() throw()
 {
     if (_own)
-        free(_code);
+        grfree(_code);
     _code = 0;
     _data = 0;
     _own  = false;
@@ -748,5 +849,5 @@ int32 Machine::Code::run(Machine & m, slotref * & map) const
 //        return m.run(_code, _data, map);
     }
 
-    return  m.run(_code, _data, map);
+    return  m.run(_code, _data, map, !_verified);
 }
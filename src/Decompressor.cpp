@@ -64,6 +64,45 @@ bool read_sequence(u8 const * &src, u8 const * const end, u8 const * &literal,
     return src <= end-MINCODA;
 }
 
+// The most a copy may run over the end of its data when there is room to.
+size_t const WILDCOPY = 32;
+
+// The room a sequence of at most a 14 byte literal and an 18 byte match
+// needs to be copied in fixed size pieces, and be sure to leave room for
+// the coda in the src buffer and the last literals in the dst buffer.
+ptrdiff_t const SHORTCUT_SRC = 32;
+size_t const    SHORTCUT_DST = 40;
+
+// Copies a match of n bytes that starts dist bytes back, which it may
+// overlap, running up to WILDCOPY-1 bytes past its end.
+inline
+u8 * copy_match(u8 * d, size_t dist, size_t n)
+{
+    u8 const * s = d - dist;
+    if (dist >= 32 && n > 16)
+        return wide_copy<32>(d, s, n);
+    if (dist >= 16)
+        return wide_copy<16>(d, s, n);
+    if (dist >= 8)
+        return wide_copy<8>(d, s, n);
+
+    // A short distance repeats a pattern of dist bytes, which equally
+    // repeats every multiple of dist bytes. Copy byte by byte until we can
+    // read from the first such multiple that is at least a word back.
+    size_t const period = dist * ((8 + dist - 1) / dist);
+    u8 * const e = d + n;
+    for (size_t i = period - dist; i; --i)
+        *d++ = *s++;
+    s = d - period;
+    while (d < e)
+    {
+        unaligned_copy<8>(d, s);
+        d += 8;
+        s += 8;
+    }
+    return e;
+}
+
 }
 
 int lz4::decompress(void const *in, size_t in_size, void *out, size_t out_size)
@@ -86,40 +125,73 @@ int lz4::decompress(void const *in, size_t in_size, void *out, size_t out_size)
         match_len = 0,
         match_dist = 0;
 
-    while (read_sequence(src, src_end, literal, literal_len, match_len,
-                         match_dist))
+    // out_size is kept as the space left in the output buffer from dst.
+    for (;;)
     {
-        if (literal_len != 0)
+        // Most sequences have a short literal and a short match that is not
+        // too close, and are far from the end of either buffer. Those can be
+        // done with a fixed size copy of each, no length bytes to read and
+        // no checks but that the match lies in the decoded output.
+        u8 const token = *src;
+        if ((token & 0xf) != 0xf && token < 0xf0
+            && src_end - src >= SHORTCUT_SRC && out_size >= SHORTCUT_DST)
         {
-            // Copy in literal. At this point the a minimal literal + minminal
-            // match plus the coda (1 + 2 + 5) must be 8 bytes or more allowing
-            // us to remain within the src buffer for an overrun_copy on
-            // machines upto 64 bits.
-            if (align(literal_len) > out_size)
-                return -1;
-            dst = overrun_copy(dst, literal, literal_len);
-            out_size -= literal_len;
+            literal_len = token >> 4;
+            match_len = (token & 0xf) + MINMATCH;
+            match_dist = src[1 + literal_len] | src[2 + literal_len] << 8;
+            if (match_dist >= 8
+                && match_dist <= size_t(dst - static_cast<u8*>(out)) + literal_len)
+            {
+                unaligned_copy<16>(dst, src + 1);
+                src += 1 + literal_len + sizeof(u16);
+                dst += literal_len;
+                u8 const * const pcpy = dst - match_dist;
+                unaligned_copy<8>(dst, pcpy);
+                unaligned_copy<8>(dst + 8, pcpy + 8);
+                unaligned_copy<2>(dst + 16, pcpy + 16);
+                dst += match_len;
+                out_size -= literal_len + match_len;
+                continue;
+            }
         }
 
-        // Copy, possibly repeating, match from earlier in the
-        //  decoded output.
-        u8 const * const pcpy = dst - match_dist;
-        if (pcpy < static_cast<u8*>(out)
-              || match_len > unsigned(out_size - LASTLITERALS)
-              // Wrap around checks:
-              || out_size < LASTLITERALS || pcpy >= dst)
+        if (!read_sequence(src, src_end, literal, literal_len, match_len,
+                           match_dist))
+            break;
+
+        // The literal and match must leave room for the last literals, and
+        // the match must lie within what has been decoded so far.
+        if (literal_len > out_size)
             return -1;
-        if (dst > pcpy+sizeof(unsigned long)
-            && align(match_len) <= out_size)
-            dst = overrun_copy(dst, pcpy, match_len);
+        out_size -= literal_len;
+        if (out_size < LASTLITERALS
+              || match_len > out_size - LASTLITERALS
+              || match_dist == 0
+              || match_dist > size_t(dst - static_cast<u8*>(out)) + literal_len)
+            return -1;
+
+        // Copy in the literal. A minimal match plus the coda (2 + 5) always
+        // follows it in the src buffer, and a minimal match plus the last
+        // literals (4 + 5) in the dst buffer, so copying a word at a time
+        // never leaves either buffer on machines up to 64 bits.
+        if (out_size >= 16 && size_t(src_end - literal) >= literal_len + 16)
+            dst = wide_copy<16>(dst, literal, literal_len);
+        else if (literal_len != 0)
+            dst = wide_copy<sizeof(unsigned long)>(dst, literal, literal_len);
+
+        // Copy, possibly repeating, the match from earlier in the decoded
+        // output, a word at a time unless that would run off the end.
+        if (out_size >= match_len + WILDCOPY)
+            dst = copy_match(dst, match_dist, match_len);
         else
-            dst = safe_copy(dst, pcpy, match_len);
+            dst = safe_copy(dst, dst - match_dist, match_len);
         out_size -= match_len;
     }
 
     if (literal > src_end - literal_len || literal_len > out_size)
         return -1;
-    dst = fast_copy(dst, literal, literal_len);
+    memcpy(dst, literal, literal_len);
+    dst += literal_len;
 
     return int(dst - (u8*)out);
 }
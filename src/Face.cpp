@@ -37,6 +37,7 @@ of the License or (at your option) any later version.
 #include "inc/Segment.h"
 #include "inc/NameTable.h"
 #include "inc/Error.h"
+#include "inc/ThreadPool.h"
 
 using namespace graphite2;
 
@@ -53,38 +54,40 @@ enum compression
 Face::Face(const void* appFaceHandle/*non-NULL*/, const gr_face_ops & ops)
 : m_appFaceHandle(appFaceHandle),
   m_pFileFace(NULL),
-  m_pGlyphFaceCache(NULL),
-  m_cmap(NULL),
-  m_pNames(NULL),
+  m_shared(NULL),
   m_logger(NULL),
+  m_threads(NULL),
+  m_memory(MemoryStats::create()),
   m_error(0), m_errcntxt(0),
-  m_silfs(NULL),
-  m_numSilf(0),
   m_ascent(0),
   m_descent(0)
+#if !defined GRAPHITE2_NTHREADS
+  , m_preloading(false)
+#endif
 {
     memset(&m_ops, 0, sizeof m_ops);
     memcpy(&m_ops, &ops, min(sizeof m_ops, ops.size));
+#if !defined GRAPHITE2_NTHREADS
+    pthread_mutex_init(&m_preloadLock, NULL);
+#endif
 }
 
 
 Face::~Face()
 {
+    waitPreloaded();
+#if !defined GRAPHITE2_NTHREADS
+    pthread_mutex_destroy(&m_preloadLock);
+#endif
     setLogger(0);
-    delete m_pGlyphFaceCache;
-    delete m_cmap;
-    delete[] m_silfs;
+    delete m_threads;
+    // Tables we have not shared may still be reading from the font.
+    if (m_shared) m_shared->release();
 #ifndef GRAPHITE2_NFILEFACE
     delete m_pFileFace;
 #endif
-    delete m_pNames;
-}
-
-float Face::default_glyph_advance(const void* font_ptr, gr_uint16 glyphid)
-{
-    const Font & font = *reinterpret_cast<const Font *>(font_ptr);
-
-    return font.face().glyphs().glyph(glyphid)->theAdvance().x * font.scale();
+    // Anything still charged to us keeps the stats alive without us.
+    if (m_memory) m_memory->release();
 }
 
 bool Face::readGlyphs(uint32 faceOptions)
@@ -94,21 +97,25 @@ bool Face::readGlyphs(uint32 faceOptions)
     telemetry::category _glyph_cat(tele.glyph);
 #endif
     error_context(EC_READGLYPHS);
-    m_pGlyphFaceCache = new GlyphCache(*this, faceOptions);
-
-    if (e.test(!m_pGlyphFaceCache, E_OUTOFMEM)
-        || e.test(m_pGlyphFaceCache->numGlyphs() == 0, E_NOGLYPHS)
-        || e.test(m_pGlyphFaceCache->unitsPerEm() == 0, E_BADUPEM))
+    if (!m_shared)
+        m_shared = new SharedFace(*this);
+    if (e.test(!m_shared, E_OUTOFMEM)) return error(e);
+
+    GlyphCache * const glyphs = m_shared->m_glyphs = new GlyphCache(*this, faceOptions);
+    if (e.test(!glyphs, E_OUTOFMEM)
+        || e.test(glyphs->numGlyphs() == 0, E_NOGLYPHS)
+        || e.test(glyphs->unitsPerEm() == 0, E_BADUPEM))
     {
         return error(e);
     }
 
-    if (faceOptions & gr_face_cacheCmap)
-        m_cmap = new CachedCmap(*this);
-    else
-        m_cmap = new DirectCmap(*this);
-    if (e.test(!m_cmap, E_OUTOFMEM) || e.test(!*m_cmap, E_BADCMAP))
+    Cmap * const cmap = m_shared->m_cmap = faceOptions & gr_face_cacheCmap
+                        ? static_cast<Cmap *>(new CachedCmap(*this))
+                        : static_cast<Cmap *>(new DirectCmap(*this));
+    if (e.test(!cmap, E_OUTOFMEM) || e.test(!*cmap, E_BADCMAP))
         return error(e);
+    if ((faceOptions & gr_face_cacheCmap) && glyphs->preloaded())
+        m_shared->m_preloaded = true;
 
     if (faceOptions & gr_face_preloadGlyphs)
         nameTable();        // preload the name table along with the glyphs.
@@ -130,25 +137,25 @@ bool Face::readGraphite(const Table & silf)
     if (e.test(version < 0x00020000, E_TOOOLD)) return error(e);
     if (version >= 0x00030000)
         be::skip<uint32>(p);        // compilerVersion
-    m_numSilf = be::read<uint16>(p);
+    const uint16 numSilf = m_shared->m_numSilf = be::read<uint16>(p);
 
     be::skip<uint16>(p);            // reserved
 
     bool havePasses = false;
-    m_silfs = new Silf[m_numSilf];
-    if (e.test(!m_silfs, E_OUTOFMEM)) return error(e);
-    for (int i = 0; i < m_numSilf; i++)
+    Silf * const silfs = m_shared->m_silfs = new Silf[numSilf];
+    if (e.test(!silfs, E_OUTOFMEM)) return error(e);
+    for (int i = 0; i < numSilf; i++)
     {
         error_context(EC_ASILF + (i << 8));
         const uint32 offset = be::read<uint32>(p),
-                     next   = i == m_numSilf - 1 ? uint32(silf.size()) : be::peek<uint32>(p);
+                     next   = i == numSilf - 1 ? uint32(silf.size()) : be::peek<uint32>(p);
         if (e.test(next > silf.size() || offset >= next, E_BADSIZE))
             return error(e);
 
-        if (!m_silfs[i].readGraphite(silf + offset, next - offset, *this, version))
+        if (!silfs[i].readGraphite(silf + offset, next - offset, *this, version))
             return false;
 
-        if (m_silfs[i].numPasses())
+        if (silfs[i].numPasses())
             havePasses = true;
     }
 
@@ -157,7 +164,57 @@ bool Face::readGraphite(const Table & silf)
 
 bool Face::readFeatures()
 {
-    return m_Sill.readFace(*this);
+    return m_shared->m_Sill.readFace(*this);
+}
+
+bool Face::findSharedTables(const void * id, size_t id_length)
+{
+    // Failing to find or make any just leaves us to load tables of our own.
+    m_shared = SharedFace::lookup(*this, id, id_length);
+    return m_shared && m_shared->loaded();
+}
+
+void Face::publishTables()
+{
+    m_shared = m_shared->publish();
+}
+
+void Face::startPreloading()
+{
+#if !defined GRAPHITE2_NTHREADS
+    m_preloading = pthread_create(&m_preloader, NULL, &Face::preloader, this) == 0;
+    if (m_preloading) return;
+#endif
+    m_shared->preload();
+}
+
+#if !defined GRAPHITE2_NTHREADS
+void * Face::preloader(void * f)
+{
+    const Face & face = *static_cast<const Face *>(f);
+    MemoryScope scope(face.memory());
+    face.m_shared->preload();
+    return NULL;
+}
+#endif
+
+bool Face::preloaded() const
+{
+    return m_shared->preloaded();
+}
+
+bool Face::waitPreloaded() const
+{
+#if !defined GRAPHITE2_NTHREADS
+    pthread_mutex_lock(&m_preloadLock);
+    if (m_preloading)
+    {
+        pthread_join(m_preloader, NULL);
+        m_preloading = false;
+    }
+    pthread_mutex_unlock(&m_preloadLock);
+#endif
+    return m_shared && m_shared->preloaded();
 }
 
 bool Face::runGraphite(Segment *seg, const Silf *aSilf) const
@@ -217,19 +274,31 @@ void Face::setLogger(FILE * log_file GR_MAYBE_UNUSED)
 #endif
 }
 
+void Face::startThreads(size_t num_workers)
+{
+    delete m_threads;
+    m_threads = num_workers ? new ThreadPool(num_workers) : 0;
+    if (m_threads && m_threads->workers() == 0)
+    {
+        delete m_threads;
+        m_threads = 0;
+    }
+}
+
 const Silf *Face::chooseSilf(uint32 script) const
 {
-    if (m_numSilf == 0)
+    const uint16 numSilf = m_shared->numSilfs();
+    if (numSilf == 0)
         return NULL;
-    else if (m_numSilf == 1 || script == 0)
-        return m_silfs;
+    else if (numSilf == 1 || script == 0)
+        return m_shared->silfs();
     else // do more work here
-        return m_silfs;
+        return m_shared->silfs();
 }
 
 uint16 Face::findPseudo(uint32 uid) const
 {
-    return (m_numSilf) ? m_silfs[0].findPseudo(uid) : 0;
+    return (m_shared->numSilfs()) ? m_shared->silfs()[0].findPseudo(uid) : 0;
 }
 
 int32 Face::getGlyphMetric(uint16 gid, uint8 metric) const
@@ -257,18 +326,14 @@ void Face::takeFileFace(FileFace* pFileFace GR_MAYBE_UNUSED/*takes ownership*/)
 
 NameTable * Face::nameTable() const
 {
-    if (m_pNames) return m_pNames;
-    const Table name(*this, Tag::name);
-    if (name)
-        m_pNames = new NameTable(name, name.size());
-    return m_pNames;
+    return m_shared->nameTable();
 }
 
 uint16 Face::languageForLocale(const char * locale) const
 {
-    nameTable();
-    if (m_pNames)
-        return m_pNames->getLanguageId(locale);
+    NameTable * const names = nameTable();
+    if (names)
+        return names->getLanguageId(locale);
     return 0;
 }
 
@@ -294,7 +359,7 @@ Face::Table::Table(const Face & face, const Tag n, uint32 version) throw()
 void Face::Table::releaseBuffers()
 {
     if (_compressed)
-        free(const_cast<byte *>(_p));
+        grfree(const_cast<byte *>(_p));
     else if (_p && _f->m_ops.release_table)
         (*_f->m_ops.release_table)(_f->m_appFaceHandle, _p);
     _p = 0; _sz = 0;
@@ -356,7 +421,7 @@ Error Face::Table::decompress()
 
     if (e)
     {
-        free(uncompressed_table);
+        grfree(uncompressed_table);
         uncompressed_table = 0;
         uncompressed_size  = 0;
     }
@@ -24,6 +24,7 @@ Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
 License, as published by the Free Software Foundation, either version 2
 of the License or (at your option) any later version.
 */
+#include <algorithm>
 #include <cstring>
 
 #include "inc/Main.h"
@@ -67,9 +68,20 @@ namespace
 
         return max_val;
     }
+
+    uint32 hashFeatures(const Features & feats)
+    {
+        uint32 h = 2166136261u;     // FNV-1a over the packed words
+        for (Features::const_iterator i = feats.begin(); i != feats.end(); ++i)
+        {
+            h ^= *i;
+            h *= 16777619u;
+        }
+        return h;
+    }
 }
 
-FeatureRef::FeatureRef(const Face & face,
+FeatureRef::FeatureRef(const SharedFace & face,
     unsigned short & bits_offset, uint32 max_val,
     uint32 name, uint16 uiName, uint16 flags,
     FeatureSetting *settings, uint16 num_set) throw()
@@ -93,7 +105,56 @@ FeatureRef::FeatureRef(const Face & face,
 
 FeatureRef::~FeatureRef() throw()
 {
-    free(m_nameValues);
+    grfree(m_nameValues);
+}
+
+SharedFeatures::SharedFeatures(const Features & feats, uint32 hash) throw()
+: m_feats(feats),
+  m_vals(0),
+  m_next(0),
+  m_owner(0),
+  m_refs(1),
+  m_hash(hash),
+  m_numFeats(0)
+{
+}
+
+void SharedFeatures::release() const
+{
+    // An unreferenced set stays in its map's table, ready for the next segment
+    // shaped with the same settings, until the table wants the room.
+    const FeatureMap * const owner = m_owner;
+    if (--m_refs == 0 && !owner)
+        delete this;
+}
+
+FeatureMap::FeatureMap()
+: m_numFeats(0), m_feats(NULL), m_pNamedFeats(NULL),
+  m_shared(NULL), m_numBuckets(0), m_numShared(0)
+{
+#if !defined GRAPHITE2_NTHREADS
+    pthread_mutex_init(&m_sharedLock, 0);
+#endif
+}
+
+FeatureMap::~FeatureMap()
+{
+    // Segments may outlive their face, so leave any sets they still hold to
+    // be freed by their last release.
+    for (size_t i = 0; i != m_numBuckets; ++i)
+        for (SharedFeatures * sf = m_shared[i], * next; sf; sf = next)
+        {
+            next = sf->m_next;
+            sf->m_owner = 0;
+            if (sf->m_refs == 0)
+                delete sf;
+        }
+    grfree(m_shared);
+#if !defined GRAPHITE2_NTHREADS
+    pthread_mutex_destroy(&m_sharedLock);
+#endif
+    delete[] m_feats;
+    delete[] m_pNamedFeats;
 }
 
 bool FeatureMap::readFeats(const Face & face)
@@ -138,7 +199,7 @@ bool FeatureMap::readFeats(const Face & face)
         if (settings_offset > size_t(feat_end - feat_start)
             || settings_offset + num_settings * FEATURE_SETTING_SIZE > size_t(feat_end - feat_start))
         {
-            free(defVals);
+            grfree(defVals);
             return false;
         }
 
@@ -149,7 +210,7 @@ bool FeatureMap::readFeats(const Face & face)
             uiSet = gralloc<FeatureSetting>(num_settings);
             if (!uiSet)
             {
-                free(defVals);
+                grfree(defVals);
                 return false;
             }
             maxVal = readFeatureSettings(feat_start + settings_offset, uiSet, num_settings);
@@ -162,7 +223,7 @@ bool FeatureMap::readFeats(const Face & face)
             defVals[i] = 0;
         }
 
-        ::new (m_feats + i) FeatureRef (face, bits, maxVal,
+        ::new (m_feats + i) FeatureRef (face.shared(), bits, maxVal,
                                        label, uiName, flags,
                                        uiSet, num_settings);
     }
@@ -170,7 +231,7 @@ bool FeatureMap::readFeats(const Face & face)
     m_pNamedFeats = new NameAndFeatureRef[m_numFeats];
     if (!m_pNamedFeats)
     {
-        free(defVals);
+        grfree(defVals);
         return false;
     }
     for (int i = 0; i < m_numFeats; ++i)
@@ -179,7 +240,7 @@ bool FeatureMap::readFeats(const Face & face)
         m_pNamedFeats[i] = m_feats[i];
     }
 
-    free(defVals);
+    grfree(defVals);
 
     qsort(m_pNamedFeats, m_numFeats, sizeof(NameAndFeatureRef), &cmpNameAndFeatures);
 
@@ -258,12 +319,128 @@ Features* SillMap::cloneFeatures(uint32 langname/*0 means default*/) const
 
 const FeatureRef *FeatureMap::findFeatureRef(uint32 name) const
 {
-    NameAndFeatureRef *it;
+    // m_pNamedFeats is sorted by name in readFeats
+    const NameAndFeatureRef * const begin = m_pNamedFeats,
+                            * const end = begin + m_numFeats,
+                            * const it = std::lower_bound(begin, end, NameAndFeatureRef(name));
+    return it != end && it->m_name == name ? it->m_pFRef : NULL;
+}
+
+const SharedFeatures *FeatureMap::share(const Features & feats) const
+{
+    const uint32 hash = hashFeatures(feats);
+#if !defined GRAPHITE2_NTHREADS
+    pthread_mutex_lock(&m_sharedLock);
+    SharedFeatures * sf = 0;
+    if (m_numBuckets)
+    {
+        for (sf = m_shared[hash & (m_numBuckets - 1)]; sf; sf = sf->m_next)
+            if (sf->m_hash == hash && sf->m_feats.m_pMap == feats.m_pMap && sf->m_feats == feats)
+                break;
+    }
+    if (sf)
+        ++sf->m_refs;
+    else if ((sf = newShared(feats, hash))
+             && (m_numShared < m_numBuckets || sweepShared() || growShared()))
+    {
+        SharedFeatures * & bucket = m_shared[hash & (m_numBuckets - 1)];
+        sf->m_next = bucket;
+        sf->m_owner = this;
+        bucket = sf;
+        ++m_numShared;
+    }
+    // If the table could not grow the set is handed out unshared.
+    pthread_mutex_unlock(&m_sharedLock);
+    return sf;
+#else
+    // Without locking the face could not be shared between threads, so
+    // every segment keeps a set of its own.
+    return newShared(feats, hash);
+#endif
+}
+
+bool FeatureMap::changeFeature(const SharedFeatures * & sf, uint8 findex, uint32 val) const
+{
+    if (findex >= m_numFeats) return false;
 
-    for (it = m_pNamedFeats; it < m_pNamedFeats + m_numFeats; ++it)
-        if (it->m_name == name)
-            return it->m_pFRef;
-    return NULL;
+    // A set in the table, or held by anyone else, is never written to. Once a
+    // segment has its own copy it keeps changing that one.
+    SharedFeatures * own = const_cast<SharedFeatures *>(sf);
+    const bool shared = sf->m_owner || sf->m_refs.load() != 1;
+    if (shared && !(own = newShared(sf->m_feats, sf->m_hash)))
+        return false;
+    if (!m_feats[findex].applyValToFeature(val, own->m_feats)
+        || m_feats[findex].getFeatureVal(own->m_feats) != val)
+    {
+        if (shared) own->release();
+        return false;
+    }
+    own->m_vals[findex] = val;
+    own->m_hash = hashFeatures(own->m_feats);
+    if (shared)
+    {
+        sf->release();
+        sf = own;
+    }
+    return true;
+}
+
+SharedFeatures *FeatureMap::newShared(const Features & feats, uint32 hash) const
+{
+    SharedFeatures * const sf = new SharedFeatures(feats, hash);
+    if (!sf) return NULL;
+    if (m_numFeats)
+    {
+        sf->m_vals = gralloc<uint32>(m_numFeats);
+        if (!sf->m_vals)
+        {
+            delete sf;
+            return NULL;
+        }
+        for (uint16 i = 0; i != m_numFeats; ++i)
+            sf->m_vals[i] = m_feats[i].getFeatureVal(feats);
+        sf->m_numFeats = m_numFeats;
+    }
+    return sf;
+}
+
+bool FeatureMap::growShared() const
+{
+    const size_t n = m_numBuckets ? 2 * m_numBuckets : 8;
+    SharedFeatures ** const buckets = grzeroalloc<SharedFeatures *>(n);
+    if (!buckets) return false;
+
+    for (size_t i = 0; i != m_numBuckets; ++i)
+        for (SharedFeatures * sf = m_shared[i], * next; sf; sf = next)
+        {
+            next = sf->m_next;
+            SharedFeatures * & bucket = buckets[sf->m_hash & (n - 1)];
+            sf->m_next = bucket;
+            bucket = sf;
+        }
+    grfree(m_shared);
+    m_shared = buckets;
+    m_numBuckets = n;
+    return true;
+}
+
+// Frees the sets no segment holds any more. Returns true if that made room.
+bool FeatureMap::sweepShared() const
+{
+    for (size_t i = 0; i != m_numBuckets; ++i)
+        for (SharedFeatures ** p = &m_shared[i]; *p;)
+        {
+            SharedFeatures * const sf = *p;
+            if (sf->m_refs == 0)
+            {
+                *p = sf->m_next;
+                --m_numShared;
+                delete sf;
+            }
+            else
+                p = &sf->m_next;
+        }
+    return m_numShared < m_numBuckets / 2;
 }
 
 bool FeatureRef::applyValToFeature(uint32 val, Features & pDest) const
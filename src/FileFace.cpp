@@ -62,7 +62,7 @@ FileFace::FileFace(const char *filename)
     if (fseek(_file, long(tbl_offset), SEEK_SET)) return;
     if (_table_dir && fread(_table_dir, 1, tbl_len, _file) != tbl_len)
     {
-        free(_table_dir);
+        grfree(_table_dir);
         _table_dir = NULL;
     }
     return;
@@ -70,8 +70,8 @@ FileFace::FileFace(const char *filename)
 
 FileFace::~FileFace()
 {
-    free(_table_dir);
-    free(_header_tbl);
+    grfree(_table_dir);
+    grfree(_header_tbl);
     if (_file)
         fclose(_file);
 }
@@ -91,10 +91,10 @@ const void *FileFace::get_table_fn(const void* appFaceHandle, unsigned int name,
             || fseek(file_face._file, long(tbl_offset), SEEK_SET) != 0)
         return 0;
 
-    tbl = malloc(tbl_len);
+    tbl = grmalloc(tbl_len);
     if (!tbl || fread(tbl, 1, tbl_len, file_face._file) != tbl_len)
     {
-        free(tbl);
+        grfree(tbl);
         return 0;
     }
 
@@ -106,7 +106,7 @@ void FileFace::rel_table_fn(const void* appFaceHandle, const void *table_buffer)
 {
     if (appFaceHandle == 0)     return;
 
-    free(const_cast<void *>(table_buffer));
+    grfree(const_cast<void *>(table_buffer));
 }
 
 const gr_face_ops FileFace::ops = { sizeof FileFace::ops, &FileFace::get_table_fn, &FileFace::rel_table_fn };
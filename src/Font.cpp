@@ -32,27 +32,96 @@ using namespace graphite2;
 
 Font::Font(float ppm, const Face & f, const void * appFontHandle, const gr_font_ops * ops)
 : m_appFontHandle(appFontHandle ? appFontHandle : this),
+  m_pages(0),
   m_face(f),
   m_scale(ppm / f.glyphs().unitsPerEm()),
-  m_hinted(appFontHandle && ops && (ops->glyph_advance_x || ops->glyph_advance_y))
+  m_numPages(0),
+  m_hinted(false)
 {
     memset(&m_ops, 0, sizeof m_ops);
-    if (m_hinted && ops)
+    if (appFontHandle && ops)
         memcpy(&m_ops, ops, min(sizeof m_ops, ops->size));
-    else
-        m_ops.glyph_advance_x = &Face::default_glyph_advance;
+    m_hinted = m_ops.glyph_advance_x || m_ops.glyph_advance_y || m_ops.glyph_advances_x;
 
-    size_t nGlyphs = f.glyphs().numGlyphs();
-    m_advances = gralloc<float>(nGlyphs);
-    if (m_advances)
+    // Unhinted advances are the design advances scaled, so only hinted fonts
+    // need a cache of their own.
+    if (m_hinted)
     {
-        for (float *advp = m_advances; nGlyphs; --nGlyphs, ++advp)
-            *advp = INVALID_ADVANCE;
+        m_numPages = (f.glyphs().numGlyphs() + PAGE_SIZE - 1) >> PAGE_BITS;
+        m_pages = grzeroalloc<float *>(m_numPages ? m_numPages : 1);
     }
 }
 
 
 /*virtual*/ Font::~Font()
 {
-    free(m_advances);
+    if (m_pages)
+        for (size_t i = 0; i != m_numPages; ++i)
+            grfree(m_pages[i]);
+    grfree(m_pages);
+}
+
+
+float * Font::newPage(unsigned short page) const
+{
+    float * const res = gralloc<float>(PAGE_SIZE);
+    if (res)
+    {
+        for (float * adv = res, * const end = res + PAGE_SIZE; adv != end; ++adv)
+            *adv = INVALID_ADVANCE;
+        m_pages[page] = res;
+    }
+    return res;
+}
+
+
+float Font::fetchAdvance(unsigned short glyphid) const
+{
+    if (m_ops.glyph_advance_x)
+        return (*m_ops.glyph_advance_x)(m_appFontHandle, glyphid);
+    if (m_ops.glyph_advances_x)
+    {
+        const uint16 gid = glyphid;
+        float res = 0.;
+        (*m_ops.glyph_advances_x)(m_appFontHandle, &gid, 1, &res);
+        return res;
+    }
+    // Only vertical hinted metrics were supplied.
+    return m_face.glyphs().glyph(glyphid)->theAdvance().x * m_scale;
+}
+
+
+// Asks the client for the advances of every glyph in glyphids that is not
+// cached yet in a single call, each glyph once however often it appears.
+void Font::prefetchAdvances(const uint16 * glyphids, size_t n) const
+{
+    if (!m_hinted || !m_ops.glyph_advances_x || !n) return;
+
+    uint16 * const todo = gralloc<uint16>(n);
+    float * const res = gralloc<float>(n);
+    if (todo && res)
+    {
+        const float pending = -2e38f;
+        const uint16 nGlyphs = m_face.glyphs().numGlyphs();
+        size_t count = 0;
+        for (const uint16 * g = glyphids, * const end = glyphids + n; g != end; ++g)
+        {
+            float * const adv = *g < nGlyphs ? cachedAdvance(*g) : 0;
+            if (adv && *adv == INVALID_ADVANCE)
+            {
+                *adv = pending;
+                todo[count++] = *g;
+            }
+        }
+        if (count)
+        {
+            (*m_ops.glyph_advances_x)(m_appFontHandle, todo, count, res);
+            // Every one of these has its page by now.
+            for (size_t i = 0; i != count; ++i)
+                *cachedAdvance(todo[i]) = res[i];
+        }
+    }
+    // On failure advance() fetches them one at a time instead.
+    grfree(todo);
+    grfree(res);
 }
@@ -124,55 +124,20 @@ GlyphCache::GlyphCache(const Face & face, const uint32 face_options)
   _num_attrs(_glyphs ? _glyph_loader->num_attrs() : 0),
   _upem(_glyphs ? _glyph_loader->units_per_em() : 0)
 {
-    if ((face_options & gr_face_preloadGlyphs) && _glyph_loader && _glyphs)
+    if ((face_options & gr_face_preloadGlyphs) && _glyph_loader && _glyphs
+        && preload(*_glyph_loader))
     {
-        int numsubs = 0;
-        GlyphFace * const glyphs = new GlyphFace [_num_glyphs];
-        if (!glyphs)
-            return;
-
-        // The 0 glyph is definately required.
-        _glyphs[0] = _glyph_loader->read_glyph(0, glyphs[0], &numsubs);
-
-        // glyphs[0] has the same address as the glyphs array just allocated,
-        //  thus assigning the &glyphs[0] to _glyphs[0] means _glyphs[0] points
-        //  to the entire array.
-        const GlyphFace * loaded = _glyphs[0];
-        for (uint16 gid = 1; loaded && gid != _num_glyphs; ++gid)
-            _glyphs[gid] = loaded = _glyph_loader->read_glyph(gid, glyphs[gid], &numsubs);
-
-        if (!loaded)
-        {
-            _glyphs[0] = 0;
-            delete [] glyphs;
-        }
-        else if (numsubs > 0 && _boxes)
-        {
-            GlyphBox * boxes = (GlyphBox *)gralloc<char>(_num_glyphs * sizeof(GlyphBox) + numsubs * 8 * sizeof(float));
-            GlyphBox * currbox = boxes;
-
-            for (uint16 gid = 0; currbox && gid != _num_glyphs; ++gid)
-            {
-                _boxes[gid] = currbox;
-                currbox = _glyph_loader->read_box(gid, currbox, *_glyphs[gid]);
-            }
-            if (!currbox)
-            {
-                free(boxes);
-                _boxes[0] = 0;
-            }
-        }
         delete _glyph_loader;
         _glyph_loader = 0;
     }
 
     if (_glyphs && glyph(0) == 0)
     {
-        free(_glyphs);
+        grfree(_glyphs);
         _glyphs = 0;
         if (_boxes)
         {
-            free(_boxes);
+            grfree(_boxes);
             _boxes = 0;
         }
         _num_glyphs = _num_attrs = _upem = 0;
@@ -180,6 +145,75 @@ GlyphCache::GlyphCache(const Face & face, const uint32 face_options)
 }
 
 
+GlyphCache::GlyphCache(const Loader & loader)
+: _glyph_loader(0),
+  _glyphs(grzeroalloc<const GlyphFace *>(loader.num_glyphs())),
+  _boxes(loader.has_boxes() ? grzeroalloc<GlyphBox *>(loader.num_glyphs()) : 0),
+  _num_glyphs(_glyphs ? loader.num_glyphs() : 0),
+  _num_attrs(_glyphs ? loader.num_attrs() : 0),
+  _upem(_glyphs ? loader.units_per_em() : 0)
+{
+    if (_glyphs)
+        preload(loader);
+}
+
+GlyphCache * GlyphCache::preload() const
+{
+    if (!_glyph_loader || !_glyphs) return 0;
+
+    GlyphCache * const res = new GlyphCache(*_glyph_loader);
+    if (res && !(res->_glyphs && res->_glyphs[0]))
+    {
+        delete res;
+        return 0;
+    }
+    return res;
+}
+
+// Reads every glyph, and its boxes, into blocks of their own. Returns false,
+// having read nothing, if out of memory.
+bool GlyphCache::preload(const Loader & loader)
+{
+    int numsubs = 0;
+    GlyphFace * const glyphs = new GlyphFace [_num_glyphs];
+    if (!glyphs)
+        return false;
+
+    // The 0 glyph is definately required.
+    _glyphs[0] = loader.read_glyph(0, glyphs[0], &numsubs);
+
+    // glyphs[0] has the same address as the glyphs array just allocated,
+    //  thus assigning the &glyphs[0] to _glyphs[0] means _glyphs[0] points
+    //  to the entire array.
+    const GlyphFace * loaded = _glyphs[0];
+    for (uint16 gid = 1; loaded && gid != _num_glyphs; ++gid)
+        _glyphs[gid] = loaded = loader.read_glyph(gid, glyphs[gid], &numsubs);
+
+    if (!loaded)
+    {
+        _glyphs[0] = 0;
+        delete [] glyphs;
+    }
+    else if (numsubs > 0 && _boxes)
+    {
+        GlyphBox * boxes = (GlyphBox *)gralloc<char>(_num_glyphs * sizeof(GlyphBox) + numsubs * 8 * sizeof(float));
+        GlyphBox * currbox = boxes;
+
+        for (uint16 gid = 0; currbox && gid != _num_glyphs; ++gid)
+        {
+            _boxes[gid] = currbox;
+            currbox = loader.read_box(gid, currbox, *_glyphs[gid]);
+        }
+        if (!currbox)
+        {
+            grfree(boxes);
+            _boxes[0] = 0;
+        }
+    }
+    return true;
+}
+
+
 GlyphCache::~GlyphCache()
 {
     if (_glyphs)
@@ -192,7 +226,7 @@ GlyphCache::~GlyphCache()
         }
         else
             delete [] _glyphs[0];
-        free(_glyphs);
+        grfree(_glyphs);
     }
     if (_boxes)
     {
@@ -200,11 +234,11 @@ GlyphCache::~GlyphCache()
         {
             GlyphBox *  * g = _boxes;
             for (uint16 n = _num_glyphs; n; --n, ++g)
-                free(*g);
+                grfree(*g);
         }
         else
-            free(_boxes[0]);
-        free(_boxes);
+            grfree(_boxes[0]);
+        grfree(_boxes);
     }
     delete _glyph_loader;
 }
@@ -229,7 +263,7 @@ const GlyphFace *GlyphCache::glyph(unsigned short glyphid) const      //result m
             _boxes[glyphid] = (GlyphBox *)gralloc<char>(sizeof(GlyphBox) + 8 * numsubs * sizeof(float));
             if (!_glyph_loader->read_box(glyphid, _boxes[glyphid], *_glyphs[glyphid]))
             {
-                free(_boxes[glyphid]);
+                grfree(_boxes[glyphid]);
                 _boxes[glyphid] = 0;
             }
         }
@@ -33,7 +33,7 @@ of the License or (at your option) any later version.
 #include "inc/Main.h"
 #include <cmath>
 
-using namespace graphite2;
+namespace graphite2 {
 
 class JustifyTotal {
 public:
@@ -60,23 +60,57 @@ void JustifyTotal::accumulate(Slot *s, Segment *seg, int level)
     m_tWeight += s->getJustify(seg, level, 3);
 }
 
-float Segment::justify(Slot *pSlot, const Font *font, float width, GR_MAYBE_UNUSED justFlags jflags, Slot *pFirst, Slot *pLast)
-{
-    Slot *s, *end;
-    float currWidth = 0.0;
-    const float scale = font ? font->scale() : 1.0f;
-    Position res;
+} // namespace graphite2
+
+using namespace graphite2;
 
+float Segment::justify(Slot *pSlot, const Font *font, float width, justFlags jflags, Slot *pFirst, Slot *pLast)
+{
     if (width < 0 && !(silf()->flags()))
         return width;
 
-    if ((m_dir & 1) != m_silf->dir() && m_silf->bidiPass() != m_silf->numPasses())
-    {
+    const bool reverse = (m_dir & 1) != m_silf->dir() && m_silf->bidiPass() != m_silf->numPasses();
+    Vector<JustifyTotal> stats;
+    if (reverse)
+        reverseSlots();
+    const float res = reverse ? justifyLine(stats, pSlot, font, width, jflags, pLast, pFirst)
+                              : justifyLine(stats, pSlot, font, width, jflags, pFirst, pLast);
+    if (reverse)
+        reverseSlots();
+    return res;
+}
+
+void Segment::justifyLines(ShapingContext *ctx, const Font *font, size_t numLines, Slot * const * starts, const float * widths, justFlags jflags, float * results)
+{
+    // Each line is justified just as justify would, but the work common to
+    // them all is done once: lines split by gr_slot_linebreak_before are
+    // unaffected by reversing the segment, so it only needs doing around the
+    // whole batch, and the statistics are allocated once for every line.
+    // The justification passes run in the caller's context, if any.
+    const bool reverse = (m_dir & 1) != m_silf->dir() && m_silf->bidiPass() != m_silf->numPasses();
+    Vector<JustifyTotal> stats;
+
+    context(ctx);
+    if (reverse)
         reverseSlots();
-        s = pFirst;
-        pFirst = pLast;
-        pLast = s;
+    for (size_t i = 0; i != numLines; ++i)
+    {
+        const float res = widths[i] < 0 && !(silf()->flags()) ? widths[i]
+                        : justifyLine(stats, starts[i], font, widths[i], jflags, 0, 0);
+        if (results) results[i] = res;
     }
+    if (reverse)
+        reverseSlots();
+    context(0);
+}
+
+float Segment::justifyLine(Vector<JustifyTotal> & stats, Slot *pSlot, const Font *font, float width, GR_MAYBE_UNUSED justFlags jflags, Slot *pFirst, Slot *pLast)
+{
+    Slot *s, *end;
+    float currWidth = 0.0;
+    const float scale = font ? font->scale() : 1.0f;
+    Position res;
+
     if (!pFirst) pFirst = pSlot;
     while (!pFirst->isBase()) pFirst = pFirst->attachedTo();
     if (!pLast) pLast = last();
@@ -123,7 +157,7 @@ float Segment::justify(Slot *pSlot, const Font *font, float width, GR_MAYBE_UNUS
         ++numLevels;
     }
 
-    Vector<JustifyTotal> stats(numLevels);
+    stats.assign(numLevels, JustifyTotal());
     for (s = pFirst; s && s != end; s = s->nextSibling())
     {
         float w = s->origin().x / scale + s->advance() - base;
@@ -187,7 +221,14 @@ float Segment::justify(Slot *pSlot, const Font *font, float width, GR_MAYBE_UNUS
     {
         m_first = pSlot = addLineEnd(pSlot);
         m_last = pLast = addLineEnd(end);
-        if (!m_first || !m_last) return -1.0;
+        if (!m_first || !m_last)
+        {
+            if (m_first) delLineEnd(m_first);
+            if (m_last) delLineEnd(m_last);
+            m_first = oldFirst;
+            m_last = oldLast;
+            return -1.0;
+        }
     }
     else
     {
@@ -229,9 +270,6 @@ float Segment::justify(Slot *pSlot, const Font *font, float width, GR_MAYBE_UNUS
     }
     m_first = oldFirst;
     m_last = oldLast;
-
-    if ((m_dir & 1) != m_silf->dir() && m_silf->bidiPass() != m_silf->numPasses())
-        reverseSlots();
     return res.x;
 }
 
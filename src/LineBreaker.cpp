@@ -0,0 +1,151 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2012, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+
+#include "inc/Segment.h"
+#include "inc/CharInfo.h"
+#include "inc/Slot.h"
+#include "inc/Main.h"
+
+using namespace graphite2;
+
+namespace
+{
+    // A place the paragraph may be broken, before slot. The line ending here
+    // measures up to end, which leaves out any trailing whitespace, and the
+    // line starting here measures from start.
+    struct Breakpoint
+    {
+        const Slot    * slot;
+        float           start,
+                        end;
+        double          cost;   // least cost of the paragraph up to here
+        size_t          prev,   // the break starting the line that ends here
+                        next;   // the break ending the line that starts here
+    };
+
+    // The breakweight between two slots is the stronger of the after weight of
+    // the character before and the before weight of the character after.
+    inline int breakWeightBefore(const Segment & seg, const Slot * s)
+    {
+        const CharInfo * const a = seg.charinfo(s->prev()->after()),
+                       * const b = seg.charinfo(s->before());
+        const int wa = a && a->breakWeight() > 0 ? a->breakWeight() : 0,
+                  wb = b && b->breakWeight() < 0 ? -b->breakWeight() : 0;
+        return max(wa, wb);
+    }
+
+    // How badly a line of natural width w fills width. Overlong lines are only
+    // ever taken when nothing else will do.
+    inline double badness(float w, float width, bool last)
+    {
+        const double slack = double(width) - double(w);
+        if (slack < 0)  return 1e12 * (1. - slack);
+        if (last)       return 0;
+        return slack * slack;
+    }
+}
+
+
+size_t Segment::breakLines(float width, int maxWeight, bool totalFit, size_t maxLines, const Slot ** breaks, float * widths) const
+{
+    if (!m_first) return 0;
+
+    // Collect the break opportunities, measuring each along the direction of
+    // the text. In rtl segments the slots run right to left from m_advance.
+    Vector<Breakpoint> bps;
+    const bool rtl = m_dir & 1;
+    float leftmost = m_advance.x,
+          spaces = -1;      // where the current run of whitespace began
+    for (const Slot * s = m_first; s; s = s->next())
+    {
+        const float pen = rtl ? m_advance.x - leftmost : s->origin().x;
+        int bw;
+        if (s == m_first || (s->isInsertBefore() && (bw = breakWeightBefore(*this, s)) > 0 && bw <= maxWeight))
+        {
+            const Breakpoint bp = { s, pen, spaces < 0 ? pen : spaces, 0., 0, 0 };
+            bps.push_back(bp);
+        }
+        const CharInfo * const c = charinfo(s->before());
+        if (c && isWhitespace(c->unicodeChar()))
+        {
+            if (spaces < 0) spaces = pen;
+        }
+        else
+            spaces = -1;
+        leftmost = min(leftmost, s->origin().x);
+    }
+    const Breakpoint end = { 0, m_advance.x, spaces < 0 ? m_advance.x : spaces, 0., 0, 0 };
+    bps.push_back(end);
+    const size_t last = bps.size() - 1;
+
+    if (totalFit)
+    {
+        // Knuth-Plass without stretch, shrink or penalties: pick the breaks
+        // that minimise the summed squared slack of all but the last line.
+        for (size_t j = 1; j <= last; ++j)
+        {
+            Breakpoint & bj = bps[j];
+            bj.cost = -1;
+            for (size_t i = j; i-- != 0;)
+            {
+                const float w = bj.end - bps[i].start;
+                if (w > width && i + 1 != j) break;
+                const double cost = bps[i].cost + badness(w, width, j == last);
+                if (bj.cost < 0 || cost < bj.cost)
+                {
+                    bj.cost = cost;
+                    bj.prev = i;
+                }
+            }
+        }
+        // Thread the chosen breaks forwards so they can be read off in order.
+        for (size_t j = last; j != 0; j = bps[j].prev)
+            bps[bps[j].prev].next = j;
+    }
+    else
+    {
+        // Fill each line with as much as fits, or take the first break if
+        // even that is too long.
+        for (size_t i = 0, j; i != last; i = j)
+        {
+            for (j = i + 1; j != last && bps[j + 1].end - bps[i].start <= width; ++j) {}
+            bps[i].next = j;
+        }
+    }
+
+    size_t n = 0;
+    for (size_t i = 0, j; i != last; i = j, ++n)
+    {
+        j = bps[i].next;
+        if (n < maxLines)
+        {
+            if (breaks) breaks[n] = bps[i].slot;
+            if (widths) widths[n] = bps[j].end - bps[i].start;
+        }
+    }
+    return n;
+}
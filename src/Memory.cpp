@@ -0,0 +1,297 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2026, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#include <cstddef>
+#include <cstring>
+#include "graphite2/Font.h"
+#include "inc/Memory.h"
+
+using namespace graphite2;
+
+namespace
+{
+    // Every block starts with its size and the face it is charged to, padded
+    // so that what follows stays suitably aligned for anything.
+    struct Header
+    {
+        size_t          size;
+        MemoryStats   * stats;
+    };
+
+    union Block
+    {
+        Header          h;
+        std::max_align_t align;
+    };
+
+    const size_t overhead = sizeof(Block);
+
+    void * std_alloc(void *, size_t n)                      { return malloc(n); }
+    void * std_realloc(void *, void * p, size_t, size_t n)  { return realloc(p, n); }
+    void   std_free(void *, void * p, size_t)               { free(p); }
+
+    gr_allocator_ops    s_ops = { sizeof(gr_allocator_ops), &std_alloc, &std_realloc, &std_free };
+    void              * s_handle = 0;
+
+    // Per thread even in GRAPHITE2_NTHREADS builds: clients may still
+    // shape separate faces on separate threads.
+    thread_local const MemoryScope * s_scope = 0;
+
+    inline
+    void * account(Block * b, size_t bytes)
+    {
+        b->h.size = bytes;
+        b->h.stats = 0;
+        if (s_scope)
+        {
+            if ((b->h.stats = s_scope->stats()) != 0)
+                b->h.stats->charge(bytes + overhead);
+            if (AllocCounts * const c = s_scope->counts())
+            {
+                ++c->allocations;
+                c->bytes += bytes;
+            }
+        }
+        return b + 1;
+    }
+}
+
+
+MemoryStats * MemoryStats::create()
+{
+    // The stats are not charged to any face, least of all their own.
+    MemoryScope none(0);
+    return new MemoryStats();
+}
+
+void MemoryStats::charge(size_t n)
+{
+    const size_t current = m_current.fetch_add(n, std::memory_order_relaxed) + n;
+    size_t peak = m_peak.load(std::memory_order_relaxed);
+    while (current > peak
+        && !m_peak.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+    {}
+}
+
+void MemoryStats::discharge(size_t n)
+{
+    if (m_current.fetch_sub(n, std::memory_order_acq_rel) == n)
+        delete this;
+}
+
+
+MemoryScope::MemoryScope(MemoryStats * stats, AllocCounts * counts) throw()
+: m_prev(s_scope),
+  m_stats(stats),
+  m_counts(counts)
+{
+    s_scope = this;
+}
+
+MemoryScope::~MemoryScope() throw()
+{
+    s_scope = m_prev;
+}
+
+const MemoryScope * MemoryScope::current() throw()
+{
+    return s_scope;
+}
+
+
+void * graphite2::grmalloc(size_t bytes)
+{
+    if (bytes > ~size_t(0) - overhead) return 0;
+    Block * const b = static_cast<Block *>((*s_ops.alloc)(s_handle, bytes + overhead));
+    return b ? account(b, bytes) : 0;
+}
+
+void * graphite2::grcalloc(size_t n, size_t size)
+{
+    size_t bytes;
+    if (checked_mul(n, size, bytes) || bytes > ~size_t(0) - overhead) return 0;
+    Block * b;
+    if (s_ops.alloc == &std_alloc)
+        b = static_cast<Block *>(calloc(1, bytes + overhead));
+    else if ((b = static_cast<Block *>((*s_ops.alloc)(s_handle, bytes + overhead))) != 0)
+        memset(b + 1, 0, bytes);
+    return b ? account(b, bytes) : 0;
+}
+
+void * graphite2::grrealloc(void * p, size_t bytes)
+{
+    if (!p) return grmalloc(bytes);
+    if (bytes > ~size_t(0) - overhead) return 0;
+
+    Block * b = static_cast<Block *>(p) - 1;
+    const size_t old = b->h.size;
+    MemoryStats * const stats = b->h.stats;
+    if (s_ops.realloc)
+        b = static_cast<Block *>((*s_ops.realloc)(s_handle, b, old + overhead, bytes + overhead));
+    else
+    {
+        Block * const nb = static_cast<Block *>((*s_ops.alloc)(s_handle, bytes + overhead));
+        if (nb)
+        {
+            memcpy(nb, b, overhead + min(old, bytes));
+            (*s_ops.free)(s_handle, b, old + overhead);
+        }
+        b = nb;
+    }
+    if (!b) return 0;
+
+    // The block stays charged to the same face whatever scope we are in.
+    b->h.size = bytes;
+    if (stats)
+    {
+        if (bytes > old)    stats->charge(bytes - old);
+        else if (bytes < old) stats->discharge(old - bytes);
+    }
+    if (AllocCounts * const c = s_scope ? s_scope->counts() : 0)
+    {
+        ++c->allocations;
+        c->bytes += bytes > old ? bytes - old : 0;
+    }
+    return b + 1;
+}
+
+void graphite2::grfree(void * p)
+{
+    if (!p) return;
+
+    Block * const b = static_cast<Block *>(p) - 1;
+    const size_t bytes = b->h.size;
+    MemoryStats * const stats = b->h.stats;
+    (*s_ops.free)(s_handle, b, bytes + overhead);
+    if (stats)
+        stats->discharge(bytes + overhead);
+}
+
+
+// Each chunk starts with a header like this, padded as a Block is, and
+// the chunks are kept in a list, newest first.
+struct Arena::Chunk
+{
+    Chunk * next;
+    size_t  size;
+};
+
+namespace
+{
+    union ChunkHeader
+    {
+        byte            h[sizeof(void *) + sizeof(size_t)];
+        std::max_align_t align;
+    };
+
+    const size_t min_chunk = 1024;
+}
+
+Arena::Arena(size_t chunk) throw()
+: m_chunks(0),
+  m_next(0),
+  m_end(0),
+  m_chunkSize(max(chunk, min_chunk)),
+  m_users(0)
+{}
+
+Arena::~Arena() throw()
+{
+    while (m_chunks)
+    {
+        Chunk * const c = m_chunks;
+        m_chunks = c->next;
+        ASAN_UNPOISON_MEMORY_REGION(reinterpret_cast<byte *>(c) + sizeof(ChunkHeader), c->size);
+        grfree(c);
+    }
+}
+
+void * Arena::grow(size_t n) throw()
+{
+    const size_t size = max(n, m_chunkSize);
+    if (size > ~size_t(0) - sizeof(ChunkHeader)) return 0;
+    Chunk * const c = static_cast<Chunk *>(grmalloc(sizeof(ChunkHeader) + size));
+    if (!c) return 0;
+    c->next = m_chunks;
+    c->size = size;
+    m_chunks = c;
+
+    // Each chunk is bigger than the last, so a few of them cover any use.
+    m_chunkSize = size + size / 2;
+    byte * const p = reinterpret_cast<byte *>(c) + sizeof(ChunkHeader);
+    ASAN_POISON_MEMORY_REGION(p, size);
+    m_next = p + n;
+    m_end = p + size;
+    return p;
+}
+
+void Arena::rewind() throw()
+{
+    if (!m_chunks) return;
+    if (m_chunks->next)
+    {
+        size_t total = 0;
+        while (m_chunks)
+        {
+            Chunk * const c = m_chunks;
+            m_chunks = c->next;
+            total += c->size;
+            ASAN_UNPOISON_MEMORY_REGION(reinterpret_cast<byte *>(c) + sizeof(ChunkHeader), c->size);
+            grfree(c);
+        }
+        m_next = m_end = 0;
+        m_chunkSize = total;
+        return;
+    }
+    m_next = reinterpret_cast<byte *>(m_chunks) + sizeof(ChunkHeader);
+    m_end = m_next + m_chunks->size;
+    ASAN_POISON_MEMORY_REGION(m_next, m_chunks->size);
+}
+
+
+extern "C" {
+
+int gr_set_allocator(const gr_allocator_ops * ops, void * handle)
+{
+    if (!ops)
+    {
+        const gr_allocator_ops std_ops = { sizeof(gr_allocator_ops), &std_alloc, &std_realloc, &std_free };
+        s_ops = std_ops;
+        s_handle = 0;
+        return 1;
+    }
+
+    gr_allocator_ops res;
+    memset(&res, 0, sizeof res);
+    memcpy(&res, ops, min(sizeof res, ops->size));
+    if (!res.alloc || !res.free)
+        return 0;
+    s_ops = res;
+    s_handle = handle;
+    return 1;
+}
+
+} // extern "C"
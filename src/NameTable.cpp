@@ -55,7 +55,7 @@ NameTable::NameTable(const void* data, size_t length, uint16 platformId, uint16
             return;
         }
     }
-    free(const_cast<TtfUtil::Sfnt::FontNames*>(m_table));
+    grfree(const_cast<TtfUtil::Sfnt::FontNames*>(m_table));
     m_table = NULL;
 }
 
@@ -160,7 +160,7 @@ void* NameTable::getName(uint16& languageId, uint16 nameId, gr_encform enc, uint
     utf16Name[utf16Length] = 0;
     if (!utf16::validate(utf16Name, utf16Name + utf16Length))
     {
-        free(utf16Name);
+        grfree(utf16Name);
         languageId = 0;
         length = 0;
         return NULL;
@@ -172,7 +172,7 @@ void* NameTable::getName(uint16& languageId, uint16 nameId, gr_encform enc, uint
         utf8::codeunit_t* uniBuffer = gralloc<utf8::codeunit_t>(3 * utf16Length + 1);
         if (!uniBuffer)
         {
-            free(utf16Name);
+            grfree(utf16Name);
             languageId = 0;
             length = 0;
             return NULL;
@@ -182,7 +182,7 @@ void* NameTable::getName(uint16& languageId, uint16 nameId, gr_encform enc, uint
             *d = *s;
         length = uint32(d - uniBuffer);
         uniBuffer[length] = 0;
-        free(utf16Name);
+        grfree(utf16Name);
         return uniBuffer;
     }
     case gr_utf16:
@@ -193,7 +193,7 @@ void* NameTable::getName(uint16& languageId, uint16 nameId, gr_encform enc, uint
         utf32::codeunit_t * uniBuffer = gralloc<utf32::codeunit_t>(utf16Length  + 1);
         if (!uniBuffer)
         {
-            free(utf16Name);
+            grfree(utf16Name);
             languageId = 0;
             length = 0;
             return NULL;
@@ -203,11 +203,11 @@ void* NameTable::getName(uint16& languageId, uint16 nameId, gr_encform enc, uint
             *d = *s;
         length = uint32(d - uniBuffer);
         uniBuffer[length] = 0;
-        free(utf16Name);
+        grfree(utf16Name);
         return uniBuffer;
     }
     }
-    free(utf16Name);
+    grfree(utf16Name);
     languageId = 0;
     length = 0;
     return NULL;
@@ -32,11 +32,13 @@ of the License or (at your option) any later version.
 #include <cstdlib>
 #include <cassert>
 #include <cmath>
+#include <algorithm>
 #include "inc/Segment.h"
 #include "inc/Code.h"
 #include "inc/Rule.h"
 #include "inc/Error.h"
 #include "inc/Collider.h"
+#include "inc/ThreadPool.h"
 
 using namespace graphite2;
 using vm::Machine;
@@ -55,6 +57,7 @@ Pass::Pass()
   m_cols(0),
   m_rules(0),
   m_ruleMap(0),
+  m_mergedRules(0),
   m_startStates(0),
   m_transitions(0),
   m_states(0),
@@ -79,15 +82,38 @@ Pass::Pass()
 
 Pass::~Pass()
 {
-    free(m_cols);
-    free(m_startStates);
-    free(m_transitions);
-    free(m_states);
-    free(m_ruleMap);
+    grfree(m_cols);
+    grfree(m_startStates);
+    grfree(m_transitions);
+    grfree(m_states);
+    grfree(m_ruleMap);
+    grfree(m_mergedRules);
 
     if (m_rules) delete [] m_rules;
     if (m_codes) delete [] m_codes;
-    free(m_progs);
+    grfree(m_progs);
+}
+
+size_t Pass::programSize() const
+{
+    size_t sz = m_cPConstraint.footprint();
+    for (const Rule * r = m_rules, * const re = r + m_numRules; r != re; ++r)
+        sz += r->constraint->footprint() + r->action->footprint();
+    return sz;
+}
+
+void Pass::packPrograms(byte * & out)
+{
+    // Lay the programs out in the order they are run: the pass constraint
+    // then each rule's constraint followed by its action.
+    m_cPConstraint.relocate(out);
+    for (vm::Machine::Code * c = m_codes, * const ce = c + m_numRules*2; c != ce; c += 2)
+    {
+        c[1].relocate(out);   // constraint
+        c[0].relocate(out);   // action
+    }
+    grfree(m_progs);
+    m_progs = 0;
 }
 
 bool Pass::readPass(const byte * const pass_start, size_t pass_length, size_t subtable_base,
@@ -187,12 +213,24 @@ bool Pass::readPass(const byte * const pass_start, size_t pass_length, size_t su
     // We should be at the end or within the pass
     if (e.test(p > pass_end, E_BADPASSLENGTH)) return face.error(e);
 
+    // All of this pass's programs are decoded into a scratch pool which the
+    // Silf packs into its single program block once every pass is loaded.
+    int totalSlots = 0;
+    for (int i = 0; i < m_numRules; ++i)
+        totalSlots += be::peek<uint16>(sort_keys + i);
+    const size_t prog_pool_sz = vm::Machine::Code::estimateCodeDataOut(aCode - pcCode
+                                    + be::peek<uint16>(o_actions + m_numRules), 2 * m_numRules + 1, totalSlots);
+    m_progs = gralloc<byte>(prog_pool_sz);
+    if (e.test(!m_progs, E_OUTOFMEM)) return face.error(e);
+    byte * prog_pool_free = m_progs;
+
     // Load the pass constraint if there is one.
     if (pass_constraint_len)
     {
         face.error_context(face.error_context() + 1);
         m_cPConstraint = vm::Machine::Code(true, pcCode, pcCode + pass_constraint_len,
-                                  precontext[0], be::peek<uint16>(sort_keys), *m_silf, face, PASS_TYPE_UNKNOWN);
+                                  precontext[0], be::peek<uint16>(sort_keys), *m_silf, face, PASS_TYPE_UNKNOWN,
+                                  &prog_pool_free);
         if (e.test(!m_cPConstraint, E_OUTOFMEM)
                 || e.test(m_cPConstraint.status() != Code::loaded, m_cPConstraint.status() + E_CODEFAILURE))
             return face.error(e);
@@ -202,7 +240,8 @@ bool Pass::readPass(const byte * const pass_start, size_t pass_length, size_t su
     {
         if (!readRanges(ranges, numRanges, e)) return face.error(e);
         if (!readRules(rule_map, numEntries,  precontext, sort_keys,
-                   o_constraint, rcCode, o_actions, aCode, face, pt, e)) return false;
+                   o_constraint, rcCode, o_actions, aCode, prog_pool_free, m_progs + prog_pool_sz,
+                   face, pt, e)) return false;
     }
 #ifdef GRAPHITE2_TELEMETRY
     telemetry::category _states_cat(face.tele.states);
@@ -215,6 +254,7 @@ bool Pass::readRules(const byte * rule_map, const size_t num_entries,
                      const byte *precontext, const uint16 * sort_key,
                      const uint16 * o_constraint, const byte *rc_data,
                      const uint16 * o_action,     const byte * ac_data,
+                     byte * & prog_pool_free, byte * const prog_pool_end,
                      Face & face, passtype pt, Error &e)
 {
     const byte * const ac_data_end = ac_data + be::peek<uint16>(o_action + m_numRules);
@@ -233,15 +273,7 @@ bool Pass::readRules(const byte * rule_map, const size_t num_entries,
     // Allocate pools
     m_rules = new Rule [m_numRules];
     m_codes = new Code [m_numRules*2];
-    int totalSlots = 0;
-    const uint16 *tsort = sort_key;
-    for (int i = 0; i < m_numRules; ++i)
-        totalSlots += be::peek<uint16>(--tsort);
-    const size_t prog_pool_sz = vm::Machine::Code::estimateCodeDataOut(ac_end - ac_data + rc_end - rc_data, 2 * m_numRules, totalSlots);
-    m_progs = gralloc<byte>(prog_pool_sz);
-    byte * prog_pool_free = m_progs,
-         * prog_pool_end  = m_progs + prog_pool_sz;
-    if (e.test(!(m_rules && m_codes && m_progs), E_OUTOFMEM)) return face.error(e);
+    if (e.test(!(m_rules && m_codes), E_OUTOFMEM)) return face.error(e);
 
     Rule * r = m_rules + m_numRules - 1;
     for (size_t n = m_numRules; r >= m_rules; --n, --r, ac_end = ac_begin, rc_end = rc_begin)
@@ -272,23 +304,6 @@ bool Pass::readRules(const byte * rule_map, const size_t num_entries,
             return face.error(e);
     }
 
-    byte * const moved_progs = prog_pool_free > m_progs ? static_cast<byte *>(realloc(m_progs, prog_pool_free - m_progs)) : 0;
-    if (e.test(!moved_progs, E_OUTOFMEM))
-    {
-        free(m_progs);
-        m_progs = 0;
-        return face.error(e);
-    }
-
-    if (moved_progs != m_progs)
-    {
-        for (Code * c = m_codes, * const ce = c + m_numRules*2; c != ce; ++c)
-        {
-            c->externalProgramMoved(moved_progs - m_progs);
-        }
-        m_progs = moved_progs;
-    }
-
     // Load the rule entries map
     face.error_context((face.error_context() & 0xFFFF00) + EC_APASS);
     //TODO: Coverity: 1315804: FORWARD_NULL
@@ -363,13 +378,164 @@ bool Pass::readStates(const byte * starts, const byte *states, const byte * o_ru
         s->rules = begin;
         s->rules_end = (end - begin <= FiniteStateMachine::MAX_RULES)? end :
             begin + FiniteStateMachine::MAX_RULES;
+        s->merged = s->merged_end = 0;
         if (begin)      // keep UBSan happy can't call qsort with null begin
             qsort(begin, end - begin, sizeof(RuleEntry), &cmpRuleEntry);
     }
 
+    mergeRuleLists();
     return true;
 }
 
+namespace
+{
+    // Tracks the candidate rule list runFSM can hold in each state.
+    class rule_list_flow
+    {
+        enum { UNSEEN, FIXED, VARIES };
+
+        const RuleEntry * * const _begin,
+                        * * const _end;
+        byte   * const _status;
+        uint16 * const _work;
+        uint16       * _top;
+
+    public:
+        rule_list_flow(size_t n)
+        : _begin(gralloc<const RuleEntry *>(n)),
+          _end(gralloc<const RuleEntry *>(n)),
+          _status(grzeroalloc<byte>(n)),
+          _work(gralloc<uint16>(2*n)),
+          _top(_work)
+        {}
+
+        ~rule_list_flow()
+        {
+            grfree(_begin); grfree(_end); grfree(_status); grfree(_work);
+        }
+
+        bool operator ! () const { return !(_begin && _end && _status && _work); }
+        bool pending() const { return _top != _work; }
+        uint16 next() { return *--_top; }
+
+        bool fixed(uint16 s) const { return _status[s] == FIXED; }
+        const RuleEntry * begin(uint16 s) const { return _begin[s]; }
+        const RuleEntry * end(uint16 s) const { return _end[s]; }
+
+        // Record that the list in state s may be [b,e), returning true if that
+        // list is now the one kept for s.  A state is queued each time its
+        // status changes, which happens at most twice.
+        bool reach(uint16 s, const RuleEntry * b, const RuleEntry * e)
+        {
+            if (_status[s] == UNSEEN)
+            {
+                _status[s] = FIXED; _begin[s] = b; _end[s] = e;
+                *_top++ = s;
+                return true;
+            }
+            if (_status[s] == FIXED && !same(_begin[s], _end[s], b, e))
+                vary(s);
+            return false;
+        }
+
+        void vary(uint16 s)
+        {
+            if (_status[s] == VARIES) return;
+            _status[s] = VARIES;
+            *_top++ = s;
+        }
+
+    private:
+        static bool same(const RuleEntry * a, const RuleEntry * const ae, const RuleEntry * b, const RuleEntry * const be)
+        {
+            if (ae - a != be - b) return false;
+            for (; a != ae; ++a, ++b)
+                if (!(*a == *b)) return false;
+            return true;
+        }
+    };
+}
+
+// Work out the candidate list each success state leaves runFSM holding.
+// Where every path into a state arrives with the same list it is stored in
+// the State, so the FSM picks it up instead of merging rule lists on every
+// transition.  This is only a speed up: states we cannot resolve, or run
+// out of room for, are left to the runtime merge.
+void Pass::mergeRuleLists()
+{
+    const size_t max_pooled = 1 << 16;
+    const size_t pool_sz = std::min(size_t(m_numSuccess) * FiniteStateMachine::MAX_RULES, max_pooled);
+    rule_list_flow flow(m_numStates);
+    RuleEntry * const pool = gralloc<RuleEntry>(pool_sz);
+    if (!flow || !pool)
+    {
+        grfree(pool);
+        return;
+    }
+    RuleEntry * pool_free = pool;
+
+    for (const uint16 * s = m_startStates, * const s_end = s + m_maxPreCtxt - m_minPreCtxt + 1; s != s_end; ++s)
+        flow.reach(*s, 0, 0);
+
+    while (flow.pending())
+    {
+        const uint16 u = flow.next();
+        if (u >= m_numTransition) continue;
+
+        for (const uint16 * t = m_transitions + u*m_numColumns, * const t_end = t + m_numColumns; t != t_end; ++t)
+        {
+            const State & st = m_states[*t];
+            // runFSM stops on reaching state 0, so arriving there only
+            // matters if it has rules of its own.
+            if (*t == 0 && (m_successStart != 0 || st.empty()))
+                continue;
+            if (*t == 0 || !flow.fixed(u))
+                flow.vary(*t);
+            else if (*t < m_successStart || st.empty())
+                flow.reach(*t, flow.begin(u), flow.end(u));
+            else if (flow.begin(u) == flow.end(u))
+                flow.reach(*t, st.rules, st.rules_end);
+            else if (size_t(pool + pool_sz - pool_free) < FiniteStateMachine::MAX_RULES)
+                flow.vary(*t);
+            else
+            {
+                RuleEntry * const e = merge_rules(flow.begin(u), flow.end(u), st.rules, st.rules_end,
+                                                  pool_free, pool_free + FiniteStateMachine::MAX_RULES);
+                if (flow.reach(*t, pool_free, e))
+                    pool_free = e;
+            }
+        }
+    }
+
+    // Keep only the pooled lists that were used.
+    const size_t used = pool_free - pool;
+    if (used)
+    {
+        m_mergedRules = gralloc<RuleEntry>(used);
+        if (!m_mergedRules)
+        {
+            grfree(pool);
+            return;
+        }
+        memcpy(m_mergedRules, pool, used * sizeof(RuleEntry));
+    }
+
+    for (uint16 n = m_successStart; n != m_numStates; ++n)
+    {
+        State & st = m_states[n];
+        if (!flow.fixed(n) || st.empty()) continue;
+        const RuleEntry * b = flow.begin(n), * e = flow.end(n);
+        if (b >= pool && b < pool_free)
+        {
+            e = m_mergedRules + (e - pool);
+            b = m_mergedRules + (b - pool);
+        }
+        st.merged = b;
+        st.merged_end = e;
+    }
+    grfree(pool);
+}
+
 bool Pass::readRanges(const byte * ranges, size_t num_ranges, Error &e)
 {
     m_cols = gralloc<uint16>(m_numGlyphs);
@@ -395,38 +561,61 @@ bool Pass::readRanges(const byte * ranges, size_t num_ranges, Error &e)
 }
 
 
+template <bool traced>
+bool Pass::runRules(Slot * s, vm::Machine & m, FiniteStateMachine & fsm) const
+{
+    Slot *currHigh = s->next();
+
+#if !defined GRAPHITE2_NTRACING
+    if (traced)  *fsm.dbgout << "rules" << json::array;
+    json::closer rules_array_closer(traced ? fsm.dbgout : 0);
+#endif
+
+    m.slotMap().highwater(currHigh);
+    int lc = m_iMaxLoop;
+    do
+    {
+        findNDoRule<traced>(s, m, fsm);
+        if (m.status() != Machine::finished) return false;
+        if (s && (s == m.slotMap().highwater() || m.slotMap().highpassed() || --lc == 0)) {
+            if (!lc)
+                s = m.slotMap().highwater();
+            lc = m_iMaxLoop;
+            if (s)
+                m.slotMap().highwater(s->next());
+        }
+    } while (s);
+    return true;
+}
+
 bool Pass::runGraphite(vm::Machine & m, FiniteStateMachine & fsm, bool reverse) const
 {
     Slot *s = m.slotMap().segment.first();
+    // Anything may have moved since the last pass.
+    m.slotMap().segment.invalidateClusterCache();
     if (!s || !testPassConstraint(m)) return true;
     if (reverse)
     {
         m.slotMap().segment.reverseSlots();
         s = m.slotMap().segment.first();
     }
-    if (m_numRules)
+    // Rule matching can be skipped when no glyph in the segment has a
+    // column in this pass's FSM, unless it is being traced.
+    const Slot * t = s;
+    if (m_numRules && !fsm.dbgout)
+        while (t && ignoresGlyph(t->gid())) t = t->next();
+    if (m_numRules && t)
     {
-        Slot *currHigh = s->next();
-
+        // An untraced run uses a rule loop that does not test the logger
+        // for every rule.
+        bool ok;
 #if !defined GRAPHITE2_NTRACING
-        if (fsm.dbgout)  *fsm.dbgout << "rules" << json::array;
-        json::closer rules_array_closer(fsm.dbgout);
+        if (fsm.dbgout)
+            ok = runRules<true>(s, m, fsm);
+        else
 #endif
-
-        m.slotMap().highwater(currHigh);
-        int lc = m_iMaxLoop;
-        do
-        {
-            findNDoRule(s, m, fsm);
-            if (m.status() != Machine::finished) return false;
-            if (s && (s == m.slotMap().highwater() || m.slotMap().highpassed() || --lc == 0)) {
-                if (!lc)
-                    s = m.slotMap().highwater();
-                lc = m_iMaxLoop;
-                if (s)
-                    m.slotMap().highwater(s->next());
-            }
-        } while (s);
+            ok = runRules<false>(s, m, fsm);
+        if (!ok) return false;
     }
     //TODO: Use enums for flags
     const bool collisions = m_numCollRuns || m_kernColls;
@@ -500,6 +689,7 @@ Slot * output_slot(const SlotMap &  slots, const int n)
 
 #endif //!defined GRAPHITE2_NTRACING
 
+template <bool traced>
 void Pass::findNDoRule(Slot * & slot, Machine &m, FiniteStateMachine & fsm) const
 {
     assert(slot);
@@ -517,7 +707,7 @@ void Pass::findNDoRule(Slot * & slot, Machine &m, FiniteStateMachine & fsm) cons
         }
 
 #if !defined GRAPHITE2_NTRACING
-        if (fsm.dbgout)
+        if (traced)
         {
             if (fsm.rules.size() != 0)
             {
@@ -733,6 +923,52 @@ void Pass::adjustSlot(int delta, Slot * & slot_out, SlotMap & smap) const
     }
 }
 
+namespace
+{
+    // The first slot of the next collision range after one ending before end.
+    inline
+    Slot * nextCollisionRange(Segment *seg, Slot *end)
+    {
+        for (Slot *s = end->prev(); s; s = s->next())
+        {
+            if (seg->collisionInfo(s)->flags() & SlotCollision::COLL_START)
+                return s;
+        }
+        return NULL;
+    }
+
+    struct CollisionRange
+    {
+        Slot  * start,
+              * end;        // one past the last slot of the range, NULL at the end of the segment
+    };
+
+    struct CollisionChain
+    {
+        const CollisionRange  * begin,
+                              * end;
+        bool    ok,
+                sensitive,  // the result depends on moved being carried in from the previous chain
+                moved;      // moved as carried out to the next chain
+    };
+
+    // Which collision ranges touch a cluster, and whether any of them may move it.
+    struct ClusterUse
+    {
+        int     first,
+                last;
+        bool    written;
+    };
+
+    struct ParallelShift
+    {
+        const Pass      * pass;
+        Segment         * seg;
+        CollisionChain  * chains;
+        int               dir;
+    };
+}
+
 bool Pass::collisionShift(Segment *seg, int dir, json * const dbgout) const
 {
     ShiftCollider shiftcoll(dbgout);
@@ -746,120 +982,297 @@ bool Pass::collisionShift(Segment *seg, int dir, json * const dbgout) const
     if (dbgout)
         *dbgout << "collisions" << json::array
             << json::flat << json::object << "num-loops" << m_numCollRuns << json::close;
+    else
 #endif
+    {
+        bool res;
+        if (seg->getFace()->threads() && collisionShiftParallel(seg, dir, res))
+            return res;
+    }
 
     while (start)
     {
+        hasCollisions = false;
+        if (!collisionShiftPhase1(seg, start, end, shiftcoll, dir, moved, hasCollisions, dbgout)
+                || !collisionShiftPhase2(seg, start, end, shiftcoll, dir, moved, hasCollisions, dbgout))
+            return false;
+        if (!end)
+            break;
+        start = nextCollisionRange(seg, end);
+    }
+    return true;
+}
+
+bool Pass::collisionShiftPhase1(Segment *seg, Slot *start, Slot * &end, ShiftCollider &shiftcoll,
+        int dir, bool &moved, bool &hasCollisions, json * const dbgout) const
+{
 #if !defined GRAPHITE2_NTRACING
-        if (dbgout)  *dbgout << json::object << "phase" << "1" << "moves" << json::array;
+    if (dbgout)  *dbgout << json::object << "phase" << "1" << "moves" << json::array;
 #endif
-        hasCollisions = false;
-        end = NULL;
-        // phase 1 : position shiftable glyphs, ignoring kernable glyphs
-        for (Slot *s = start; s; s = s->next())
+    end = NULL;
+    // phase 1 : position shiftable glyphs, ignoring kernable glyphs
+    for (Slot *s = start; s; s = s->next())
+    {
+        const SlotCollision * c = seg->collisionInfo(s);
+        if (start && (c->flags() & (SlotCollision::COLL_FIX | SlotCollision::COLL_KERN)) == SlotCollision::COLL_FIX
+                  && !resolveCollisions(seg, s, start, shiftcoll, false, dir, moved, hasCollisions, dbgout))
+            return false;
+        if (s != start && (c->flags() & SlotCollision::COLL_END))
         {
-            const SlotCollision * c = seg->collisionInfo(s);
-            if (start && (c->flags() & (SlotCollision::COLL_FIX | SlotCollision::COLL_KERN)) == SlotCollision::COLL_FIX
-                      && !resolveCollisions(seg, s, start, shiftcoll, false, dir, moved, hasCollisions, dbgout))
-                return false;
-            if (s != start && (c->flags() & SlotCollision::COLL_END))
-            {
-                end = s->next();
-                break;
-            }
+            end = s->next();
+            break;
         }
+    }
 
 #if !defined GRAPHITE2_NTRACING
-        if (dbgout)
-            *dbgout << json::close << json::close; // phase-1
+    if (dbgout)
+        *dbgout << json::close << json::close; // phase-1
 #endif
+    return true;
+}
 
-        // phase 2 : loop until happy.
-        for (int i = 0; i < m_numCollRuns - 1; ++i)
+bool Pass::collisionShiftPhase2(Segment *seg, Slot *start, Slot *end, ShiftCollider &shiftcoll,
+        int dir, bool &moved, bool &hasCollisions, json * const dbgout) const
+{
+    // phase 2 : loop until happy.
+    for (int i = 0; i < m_numCollRuns - 1; ++i)
+    {
+        if (hasCollisions || moved)
         {
-            if (hasCollisions || moved)
-            {
 
 #if !defined GRAPHITE2_NTRACING
-                if (dbgout)
-                    *dbgout << json::object << "phase" << "2a" << "loop" << i << "moves" << json::array;
+            if (dbgout)
+                *dbgout << json::object << "phase" << "2a" << "loop" << i << "moves" << json::array;
 #endif
-                // phase 2a : if any shiftable glyphs are in collision, iterate backwards,
-                // fixing them and ignoring other non-collided glyphs. Note that this handles ONLY
-                // glyphs that are actually in collision from phases 1 or 2b, and working backwards
-                // has the intended effect of breaking logjams.
-                if (hasCollisions)
+            // phase 2a : if any shiftable glyphs are in collision, iterate backwards,
+            // fixing them and ignoring other non-collided glyphs. Note that this handles ONLY
+            // glyphs that are actually in collision from phases 1 or 2b, and working backwards
+            // has the intended effect of breaking logjams.
+            if (hasCollisions)
+            {
+                hasCollisions = false;
+                #if 0
+                moved = true;
+                for (Slot *s = start; s != end; s = s->next())
                 {
-                    hasCollisions = false;
-                    #if 0
-                    moved = true;
-                    for (Slot *s = start; s != end; s = s->next())
-                    {
-                        SlotCollision * c = seg->collisionInfo(s);
-                        c->setShift(Position(0, 0));
-                    }
-                    #endif
-                    Slot *lend = end ? end->prev() : seg->last();
-                    Slot *lstart = start->prev();
-                    for (Slot *s = lend; s != lstart; s = s->prev())
+                    SlotCollision * c = seg->collisionInfo(s);
+                    c->setShift(Position(0, 0));
+                }
+                #endif
+                Slot *lend = end ? end->prev() : seg->last();
+                Slot *lstart = start->prev();
+                for (Slot *s = lend; s != lstart; s = s->prev())
+                {
+                    SlotCollision * c = seg->collisionInfo(s);
+                    if (start && (c->flags() & (SlotCollision::COLL_FIX | SlotCollision::COLL_KERN | SlotCollision::COLL_ISCOL))
+                                    == (SlotCollision::COLL_FIX | SlotCollision::COLL_ISCOL)) // ONLY if this glyph is still colliding
                     {
-                        SlotCollision * c = seg->collisionInfo(s);
-                        if (start && (c->flags() & (SlotCollision::COLL_FIX | SlotCollision::COLL_KERN | SlotCollision::COLL_ISCOL))
-                                        == (SlotCollision::COLL_FIX | SlotCollision::COLL_ISCOL)) // ONLY if this glyph is still colliding
-                        {
-                            if (!resolveCollisions(seg, s, lend, shiftcoll, true, dir, moved, hasCollisions, dbgout))
-                                return false;
-                            c->setFlags(c->flags() | SlotCollision::COLL_TEMPLOCK);
-                        }
+                        if (!resolveCollisions(seg, s, lend, shiftcoll, true, dir, moved, hasCollisions, dbgout))
+                            return false;
+                        c->setFlags(c->flags() | SlotCollision::COLL_TEMPLOCK);
                     }
                 }
+            }
 
 #if !defined GRAPHITE2_NTRACING
-                if (dbgout)
-                    *dbgout << json::close << json::close // phase 2a
-                        << json::object << "phase" << "2b" << "loop" << i << "moves" << json::array;
+            if (dbgout)
+                *dbgout << json::close << json::close // phase 2a
+                    << json::object << "phase" << "2b" << "loop" << i << "moves" << json::array;
 #endif
 
-                // phase 2b : redo basic diacritic positioning pass for ALL glyphs. Each successive loop adjusts
-                // glyphs from their current adjusted position, which has the effect of gradually minimizing the
-                // resulting adjustment; ie, the final result will be gradually closer to the original location.
-                // Also it allows more flexibility in the final adjustment, since it is moving along the
-                // possible 8 vectors from successively different starting locations.
-                if (moved)
+            // phase 2b : redo basic diacritic positioning pass for ALL glyphs. Each successive loop adjusts
+            // glyphs from their current adjusted position, which has the effect of gradually minimizing the
+            // resulting adjustment; ie, the final result will be gradually closer to the original location.
+            // Also it allows more flexibility in the final adjustment, since it is moving along the
+            // possible 8 vectors from successively different starting locations.
+            if (moved)
+            {
+                moved = false;
+                for (Slot *s = start; s != end; s = s->next())
                 {
-                    moved = false;
-                    for (Slot *s = start; s != end; s = s->next())
-                    {
-                        SlotCollision * c = seg->collisionInfo(s);
-                        if (start && (c->flags() & (SlotCollision::COLL_FIX | SlotCollision::COLL_TEMPLOCK
-                                                        | SlotCollision::COLL_KERN)) == SlotCollision::COLL_FIX
-                                  && !resolveCollisions(seg, s, start, shiftcoll, false, dir, moved, hasCollisions, dbgout))
-                            return false;
-                        else if (c->flags() & SlotCollision::COLL_TEMPLOCK)
-                            c->setFlags(c->flags() & ~SlotCollision::COLL_TEMPLOCK);
-                    }
+                    SlotCollision * c = seg->collisionInfo(s);
+                    if (start && (c->flags() & (SlotCollision::COLL_FIX | SlotCollision::COLL_TEMPLOCK
+                                                    | SlotCollision::COLL_KERN)) == SlotCollision::COLL_FIX
+                              && !resolveCollisions(seg, s, start, shiftcoll, false, dir, moved, hasCollisions, dbgout))
+                        return false;
+                    else if (c->flags() & SlotCollision::COLL_TEMPLOCK)
+                        c->setFlags(c->flags() & ~SlotCollision::COLL_TEMPLOCK);
                 }
-        //      if (!hasCollisions) // no, don't leave yet because phase 2b will continue to improve things
-        //          break;
+            }
+    //      if (!hasCollisions) // no, don't leave yet because phase 2b will continue to improve things
+    //          break;
 #if !defined GRAPHITE2_NTRACING
-                if (dbgout)
-                    *dbgout << json::close << json::close; // phase 2
+            if (dbgout)
+                *dbgout << json::close << json::close; // phase 2
 #endif
+        }
+    }
+    return true;
+}
+
+// Resolve one chain of collision ranges, in order, on whichever thread picks it up.
+void Pass::collisionShiftChain(void *ctx, size_t n)
+{
+    const ParallelShift & ps = *static_cast<const ParallelShift *>(ctx);
+    CollisionChain & chain = ps.chains[n];
+    ShiftCollider shiftcoll(NULL);
+    bool moved = chain.moved;
+
+    chain.ok = true;
+    chain.sensitive = false;
+    for (const CollisionRange *r = chain.begin; chain.ok && r != chain.end; ++r)
+    {
+        bool hasCollisions = false;
+        Slot *end;
+        chain.ok = ps.pass->collisionShiftPhase1(ps.seg, r->start, end, shiftcoll, ps.dir, moved, hasCollisions, NULL);
+        if (r == chain.begin)
+            chain.sensitive = !moved && ps.pass->m_numCollRuns > 1;
+        chain.ok = chain.ok && end == r->end
+                && ps.pass->collisionShiftPhase2(ps.seg, r->start, end, shiftcoll, ps.dir, moved, hasCollisions, NULL);
+    }
+    chain.moved = moved;
+}
+
+// Collision ranges only look at the slots between their start and end, so
+// ranges that share no slots and no clusters can be resolved concurrently.
+// Overlapping ranges are grouped into chains that are resolved serially. The
+// only state the serial resolver carries from one range to the next is the
+// moved flag, so any chain whose outcome would have depended on it is rolled
+// back and resolved again once its predecessor is known, which keeps the
+// result identical to serial resolution. Returns false if the segment is
+// unsuitable, in which case the caller resolves it serially.
+bool Pass::collisionShiftParallel(Segment *seg, int dir, bool &res) const
+{
+    const size_t n = seg->slotCount();
+    const GlyphCache & gc = seg->getFace()->glyphs();
+    Vector<CollisionRange> ranges;
+    Vector<CollisionChain> chains;
+    ClusterUse * const uses = gralloc<ClusterUse>(n);
+    bool handled = false;
+    if (!uses) return false;
+    memset(uses, 0xFF, n * sizeof(ClusterUse));
+
+    // Each slot needs its own collision info, and exclusion glyphs make
+    // temporary slots in the segment, so both force serial resolution. The
+    // glyph cache fills in lazily, so load everything the ranges will look at
+    // before any other thread gets to it.
+    for (Slot *s = seg->first(); s; s = s->next())
+    {
+        if (s->index() >= n || uses[s->index()].first != -1
+                || seg->collisionInfo(s)->exclGlyph() > 0)
+        {
+            grfree(uses);
+            return false;
+        }
+        uses[s->index()].first = 0;
+        gc.glyph(s->gid());
+    }
+
+    for (Slot *start = seg->first(); start; )
+    {
+        CollisionRange r = { start, NULL };
+        for (Slot *s = start->next(); s; s = s->next())
+        {
+            if (seg->collisionInfo(s)->flags() & SlotCollision::COLL_END)
+            {
+                r.end = s->next();
+                break;
             }
         }
-        if (!end)
+        ranges.push_back(r);
+        if (!r.end)
             break;
-        start = NULL;
-        for (Slot *s = end->prev(); s; s = s->next())
+        start = nextCollisionRange(seg, r.end);
+    }
+
+    // A range only moves the clusters of its shiftable slots. Any cluster that
+    // is moved by one range and looked at by another ties those two ranges,
+    // and everything between them, into the same chain. Clusters that are only
+    // looked at, such as the base a range starts from, can be shared freely.
+    for (size_t i = 0; i != n; ++i)
+    {
+        uses[i].first = uses[i].last = -1;
+        uses[i].written = false;
+    }
+    for (size_t i = 0; i != ranges.size(); ++i)
+    {
+        for (Slot *s = ranges[i].start; s != ranges[i].end; s = s->next())
         {
-            if (seg->collisionInfo(s)->flags() & SlotCollision::COLL_START)
+            ClusterUse & u = uses[seg->findRoot(s)->index()];
+            if (u.first < 0) u.first = int(i);
+            u.last = int(i);
+            if ((seg->collisionInfo(s)->flags() & (SlotCollision::COLL_FIX | SlotCollision::COLL_KERN))
+                    == SlotCollision::COLL_FIX)
+                u.written = true;
+        }
+    }
+    Vector<size_t> joins(ranges.size());
+    for (size_t i = 0; i != ranges.size(); ++i)
+        joins[i] = i;
+    for (size_t i = 0; i != n; ++i)
+    {
+        const ClusterUse & u = uses[i];
+        if (u.written && u.first != u.last && size_t(u.first) < joins[u.last])
+            joins[u.last] = u.first;
+    }
+    for (size_t i = ranges.size(), lowest = i; i; --i)
+    {
+        lowest = min(lowest, joins[i - 1]);
+        if (lowest == i - 1)
+        {
+            CollisionChain c = { ranges.begin() + lowest, chains.empty() ? ranges.end() : chains.back().begin, true, false, false };
+            chains.push_back(c);
+        }
+    }
+
+    if (chains.size() > 1)
+    {
+        // The chains were found back to front.
+        for (CollisionChain *a = chains.begin(), *b = chains.end() - 1; a < b; ++a, --b)
+        {
+            const CollisionChain t = *a; *a = *b; *b = t;
+        }
+
+        // Remember where each slot started so a chain can be rolled back.
+        Position      * const positions = gralloc<Position>(n);
+        SlotCollision * const colls = gralloc<SlotCollision>(n);
+        ParallelShift ps = { this, seg, chains.begin(), dir };
+        if (positions && colls)
+        {
+            for (Slot *s = seg->first(); s; s = s->next())
             {
-                start = s;
-                break;
+                positions[s->index()] = s->origin();
+                colls[s->index()] = *seg->collisionInfo(s);
+            }
+            handled = seg->getFace()->threads()->run(&Pass::collisionShiftChain, &ps, chains.size());
+        }
+
+        res = true;
+        for (CollisionChain *c = chains.begin(); handled && c != chains.end(); ++c)
+        {
+            if (c->sensitive && c != chains.begin() && c[-1].moved)
+            {
+                // Roll back every cluster this chain moved and redo it
+                // with the moved flag it would have seen serially.
+                for (Slot *s = seg->first(); s; s = s->next())
+                {
+                    const ClusterUse & u = uses[seg->findRoot(s)->index()];
+                    if (u.written && ranges.begin() + u.first >= c->begin && ranges.begin() + u.first < c->end)
+                    {
+                        s->position(positions[s->index()]);
+                        *seg->collisionInfo(s) = colls[s->index()];
+                    }
+                }
+                c->moved = true;
+                collisionShiftChain(&ps, c - chains.begin());
             }
+            res &= c->ok;
         }
+        grfree(positions);
+        grfree(colls);
     }
-    return true;
+    grfree(uses);
+    return handled;
 }
 
 bool Pass::collisionKern(Segment *seg, int dir, json * const dbgout) const
@@ -914,6 +1327,7 @@ bool Pass::collisionFinish(Segment *seg, GR_MAYBE_UNUSED json * const dbgout) co
             const Position nullPosition(0, 0);
             c->setOffset(newOffset + c->offset());
             c->setShift(nullPosition);
+            s->invalidatePosition();
         }
     }
 //    seg->positionSlots();
@@ -1002,6 +1416,7 @@ bool Pass::resolveCollisions(Segment *seg, Slot *slotFix, Slot *start,
                 Position here = slotFix->origin() + shift;
                 float clusterMin = here.x;
                 slotFix->firstChild()->finalise(seg, NULL, here, bbox, 0, clusterMin, rtl, false);
+                slotFix->invalidatePosition();
             }
         }
     }
@@ -1046,6 +1461,7 @@ float Pass::resolveKern(Segment *seg, Slot *slotFix, GR_MAYBE_UNUSED Slot *start
     if (base != slotFix)
     {
         cFix->setFlags(cFix->flags() | SlotCollision::COLL_KERN | SlotCollision::COLL_FIX);
+        base->invalidatePosition();
         return 0;
     }
     bool seenEnd = (cFix->flags() & SlotCollision::COLL_END) != 0;
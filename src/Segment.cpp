@@ -42,39 +42,50 @@ of the License or (at your option) any later version.
 
 using namespace graphite2;
 
-Segment::Segment(size_t numchars, const Face* face, uint32 script, int textDir)
-: m_freeSlots(NULL),
+Segment::Segment(size_t numchars, const Face* face, uint32 script, int textDir, Arena * arena)
+: m_arena(arena ? arena : &m_ownArena),
+  m_freeSlots(NULL),
   m_freeJustifies(NULL),
-  m_charinfo(new CharInfo[numchars]),
+  m_charinfo(NULL),
   m_collisions(NULL),
   m_face(face),
   m_silf(face->chooseSilf(script)),
+  m_context(0),
   m_first(NULL),
   m_last(NULL),
   m_bufSize(numchars + 10),
   m_numGlyphs(numchars),
   m_numCharinfo(numchars),
+  m_slotsInUse(0),
+  m_slotsHighWater(0),
+  m_slotPoolSize(0),
   m_defaultOriginal(0),
   m_dir(textDir),
-  m_flags(((m_silf->flags() & 0x20) != 0) << 1),
+  m_flags((((m_silf->flags() & 0x20) != 0) << 1) | (m_silf->canSkipPasses() ? SEG_INERT : 0)),
   m_passBits(m_silf->aPassBits() ? -1 : 0)
 {
+    invalidateClusterCache();
+    invalidatePositions();
+    // Size our own arena's first chunk to hold the charinfo and first slot
+    // buffer, which is all most segments need.
+    if (!arena)
+        m_ownArena.reserve(numchars * sizeof(CharInfo)
+                         + m_bufSize * (sizeof(Slot) + (m_silf->numUser() + 1) * sizeof(int16)) + 256);
+    m_charinfo = m_arena->alloc<CharInfo>(numchars);
+    if (m_charinfo)
+        for (size_t i = 0; i != numchars; ++i)
+            ::new (m_charinfo + i) CharInfo();
     Slot *s = newSlot();
     if (s)
         freeSlot(s);
     m_bufSize = log_binary(numchars)+1;
 }
 
+// Everything else was allocated from the arena and goes with it.
 Segment::~Segment()
 {
-    for (SlotRope::iterator i = m_slots.begin(); i != m_slots.end(); ++i)
-        free(*i);
-    for (AttributeRope::iterator i = m_userAttrs.begin(); i != m_userAttrs.end(); ++i)
-        free(*i);
-    for (JustifyRope::iterator i = m_justifies.begin(); i != m_justifies.end(); ++i)
-        free(*i);
-    delete[] m_charinfo;
-    free(m_collisions);
+    for (FeatureList::iterator i = m_feats.begin(); i != m_feats.end(); ++i)
+        (*i)->release();
 }
 
 void Segment::appendSlot(int id, int cid, int gid, int iFeats, size_t coffset)
@@ -104,6 +115,7 @@ void Segment::appendSlot(int id, int cid, int gid, int iFeats, size_t coffset)
 
 Slot *Segment::newSlot()
 {
+    invalidateClusterCache();
     if (!m_freeSlots)
     {
         // check that the segment doesn't grow indefinintely
@@ -113,14 +125,10 @@ Slot *Segment::newSlot()
 #if !defined GRAPHITE2_NTRACING
         if (m_face->logger()) ++numUser;
 #endif
-        Slot *newSlots = grzeroalloc<Slot>(m_bufSize);
-        int16 *newAttrs = grzeroalloc<int16>(m_bufSize * numUser);
+        Slot *newSlots = m_arena->zeroalloc<Slot>(m_bufSize);
+        int16 *newAttrs = m_arena->zeroalloc<int16>(m_bufSize * numUser);
         if (!newSlots || !newAttrs)
-        {
-            free(newSlots);
-            free(newAttrs);
             return NULL;
-        }
         for (size_t i = 0; i < m_bufSize; i++)
         {
             ::new (newSlots + i) Slot(newAttrs + i * numUser);
@@ -128,21 +136,24 @@ Slot *Segment::newSlot()
         }
         newSlots[m_bufSize - 1].next(NULL);
         newSlots[0].next(NULL);
-        m_slots.push_back(newSlots);
-        m_userAttrs.push_back(newAttrs);
+        m_slotPoolSize += m_bufSize;
         m_freeSlots = (m_bufSize > 1)? newSlots + 1 : NULL;
+        if (++m_slotsInUse > m_slotsHighWater) m_slotsHighWater = m_slotsInUse;
         return newSlots;
     }
     Slot *res = m_freeSlots;
     m_freeSlots = m_freeSlots->next();
     res->next(NULL);
+    if (++m_slotsInUse > m_slotsHighWater) m_slotsHighWater = m_slotsInUse;
     return res;
 }
 
 void Segment::freeSlot(Slot *aSlot)
 {
+    invalidateClusterCache();
     if (m_last == aSlot) m_last = aSlot->prev();
     if (m_first == aSlot) m_first = aSlot->next();
+    aSlot->invalidatePosition();
     if (aSlot->attachedTo())
         aSlot->attachedTo()->removeChild(aSlot);
     while (aSlot->firstChild())
@@ -150,11 +161,13 @@ void Segment::freeSlot(Slot *aSlot)
         if (aSlot->firstChild()->attachedTo() == aSlot)
         {
             aSlot->firstChild()->attachTo(NULL);
+            aSlot->firstChild()->invalidatePosition();
             aSlot->removeChild(aSlot->firstChild());
         }
         else
             aSlot->firstChild(NULL);
     }
+    aSlot->releaseJustify(this);
     // reset the slot incase it is reused
     ::new (aSlot) Slot(aSlot->userAttrs());
     memset(aSlot->userAttrs(), 0, m_silf->numUser() * sizeof(int16));
@@ -169,6 +182,7 @@ void Segment::freeSlot(Slot *aSlot)
     else
         aSlot->next(m_freeSlots);
     m_freeSlots = aSlot;
+    --m_slotsInUse;
 }
 
 SlotJustify *Segment::newJustify()
@@ -176,7 +190,7 @@ SlotJustify *Segment::newJustify()
     if (!m_freeJustifies)
     {
         const size_t justSize = SlotJustify::size_of(m_silf->numJustLevels());
-        byte *justs = grzeroalloc<byte>(justSize * m_bufSize);
+        byte *justs = m_arena->zeroalloc<byte>(justSize * m_bufSize);
         if (!justs) return NULL;
         for (ptrdiff_t i = m_bufSize - 2; i >= 0; --i)
         {
@@ -185,11 +199,10 @@ SlotJustify *Segment::newJustify()
             p->next = next;
         }
         m_freeJustifies = (SlotJustify *)justs;
-        m_justifies.push_back(m_freeJustifies);
     }
     SlotJustify *res = m_freeJustifies;
     m_freeJustifies = m_freeJustifies->next;
-    res->next = NULL;
+    res->refs = 1;
     return res;
 }
 
@@ -286,14 +299,31 @@ void Segment::linkClusters(Slot *s, Slot * end)
     }
 }
 
+Position Segment::positionCluster(Slot *s, const Font *font, Position base, Rect &bbox, float &clusterMin, bool isRtl, bool isFinal)
+{
+    if (!s->isBase())
+        return base;
+    if (s->isPositioned() && s->m_layoutBase.x == base.x && s->m_layoutBase.y == base.y)
+        return s->m_layoutEnd;
+
+    s->m_layoutBase = base;
+    s->m_layoutEnd = s->finalise(this, font, base, bbox, 0, clusterMin = base.x, isRtl, isFinal);
+    s->markPositioned(true);
+    return s->m_layoutEnd;
+}
+
 Position Segment::positionSlots(const Font *font, Slot * iStart, Slot * iEnd, bool isRtl, bool isFinal)
 {
     Position currpos(0., 0.);
     float clusterMin = 0.;
     Rect bbox;
     bool reorder = (currdir() != isRtl);
+    // The whole segment can be visited in reversed order where it lies,
+    // anything else is reversed and put back.
+    const bool inplace = reorder && !iStart && !iEnd && m_first;
 
-    if (reorder)
+    invalidateClusterCache();
+    if (reorder && !inplace)
     {
         Slot *temp;
         reverseSlots();
@@ -307,21 +337,95 @@ Position Segment::positionSlots(const Font *font, Slot * iStart, Slot * iEnd, bo
     if (!iStart || !iEnd)   // only true for empty segments
         return currpos;
 
-    if (isRtl)
+    if (font && font->isHinted() && font->batchesAdvances())
     {
-        for (Slot * s = iEnd, * const end = iStart->prev(); s && s != end; s = s->prev())
+        Vector<uint16> glyphs;
+        glyphs.reserve(m_numGlyphs);
+        for (Slot * s = iStart, * const end = iEnd->next(); s != end; s = s->next())
+            glyphs.push_back(s->glyph());
+        font->prefetchAdvances(glyphs.begin(), glyphs.size());
+    }
+
+    // A cluster that has not changed since it was last laid out, for the same
+    // font and direction, and that starts in the same place, ends up exactly
+    // where it did last time, so it can be skipped.
+    if (!m_positioned.valid || m_positioned.font != font
+            || m_positioned.rtl != isRtl || m_positioned.isFinal != isFinal)
+    {
+        for (Slot * s = m_first; s; s = s->next())
+            s->markPositioned(false);
+        m_positioned.font = font;
+        m_positioned.rtl = isRtl;
+        m_positioned.isFinal = isFinal;
+        m_positioned.valid = true;
+    }
+
+    if (inplace)
+    {
+        // reverseSlots leaves a leading run of diacritics where it is and
+        // keeps every other run after the slot it follows, while reversing
+        // the order of those groups. Walk the groups in that order instead.
+        Slot *firstGroup = m_first;
+        while (firstGroup && getSlotBidiClass(firstGroup) == 16)
+            firstGroup = firstGroup->next();
+        if (!firstGroup || m_first == m_last)
+        {
+            // reverseSlots would leave these alone.
+            if (isRtl)
+                for (Slot * s = m_last; s; s = s->prev())
+                    currpos = positionCluster(s, font, currpos, bbox, clusterMin, isRtl, isFinal);
+            else
+                for (Slot * s = m_first; s; s = s->next())
+                    currpos = positionCluster(s, font, currpos, bbox, clusterMin, isRtl, isFinal);
+        }
+        else if (isRtl)
+        {
+            // Reversed order, backwards: each group back to front, first to
+            // last, then the leading run back to front.
+            for (Slot * g = firstGroup; g; )
+            {
+                Slot * next = g->next();
+                while (next && getSlotBidiClass(next) == 16)
+                    next = next->next();
+                for (Slot * s = next ? next->prev() : m_last; ; s = s->prev())
+                {
+                    currpos = positionCluster(s, font, currpos, bbox, clusterMin, isRtl, isFinal);
+                    if (s == g) break;
+                }
+                g = next;
+            }
+            for (Slot * s = firstGroup->prev(); s; s = s->prev())
+                currpos = positionCluster(s, font, currpos, bbox, clusterMin, isRtl, isFinal);
+        }
+        else
         {
-            if (s->isBase())
-                currpos = s->finalise(this, font, currpos, bbox, 0, clusterMin = currpos.x, isRtl, isFinal);
+            // Reversed order, forwards: the leading run, then each group
+            // front to back, last to first.
+            for (Slot * s = m_first; s != firstGroup; s = s->next())
+                currpos = positionCluster(s, font, currpos, bbox, clusterMin, isRtl, isFinal);
+            for (Slot * g = m_last, * end = NULL; ; )
+            {
+                while (getSlotBidiClass(g) == 16)
+                    g = g->prev();
+                for (Slot * s = g; s != end; s = s->next())
+                    currpos = positionCluster(s, font, currpos, bbox, clusterMin, isRtl, isFinal);
+                if (g == firstGroup) break;
+                end = g;
+                g = g->prev();
+            }
         }
+        return currpos;
+    }
+
+    if (isRtl)
+    {
+        for (Slot * s = iEnd, * const end = iStart->prev(); s && s != end; s = s->prev())
+            currpos = positionCluster(s, font, currpos, bbox, clusterMin, isRtl, isFinal);
     }
     else
     {
         for (Slot * s = iStart, * const end = iEnd->next(); s && s != end; s = s->next())
-        {
-            if (s->isBase())
-                currpos = s->finalise(this, font, currpos, bbox, 0, clusterMin = currpos.x, isRtl, isFinal);
-        }
+            currpos = positionCluster(s, font, currpos, bbox, clusterMin, isRtl, isFinal);
     }
     if (reorder)
         reverseSlots();
@@ -329,6 +433,30 @@ Position Segment::positionSlots(const Font *font, Slot * iStart, Slot * iEnd, bo
 }
 
 
+int Segment::addFeatures(const Features& feats)
+{
+    // The face keeps feature settings already unpacked, so rules reading
+    // them with PUSH_FEAT only have to index an array.
+    const SharedFeatures * const sf = m_face->theSill().theFeatureMap().share(feats);
+    if (!sf) return -1;
+    m_feats.push_back(sf);
+    return int(m_feats.size()) - 1;
+}
+
+bool Segment::setFeature(int index, uint8 findex, uint32 val)
+{
+    const FeatureMap & fmap = m_face->theSill().theFeatureMap();
+    const FeatureRef* pFR=fmap.featureRef(findex);
+    if (!pFR) return true;
+    if (val > pFR->maxVal()) val = pFR->maxVal();
+    if (val == m_feats[index]->value(findex)) return true;
+
+    // The first change takes a copy of the shared settings for this segment,
+    // later ones just write to it.
+    return fmap.changeFeature(m_feats[index], findex, val);
+}
+
+
 void Segment::associateChars(int offset, size_t numChars)
 {
     int i = 0, j = 0;
@@ -389,12 +517,15 @@ bool Segment::read_text(const Face *face, const Features* pFeats/*must not be NU
     assert(pFeats);
     if (!m_charinfo) return false;
 
+    const int fid = addFeatures(*pFeats);
+    if (fid < 0) return false;
+
     // utf iterator is self recovering so we don't care about the error state of the iterator.
     switch (enc)
     {
-    case gr_utf8:   process_utf_data(*this, *face, addFeatures(*pFeats), utf8::const_iterator(pStart), nChars); break;
-    case gr_utf16:  process_utf_data(*this, *face, addFeatures(*pFeats), utf16::const_iterator(pStart), nChars); break;
-    case gr_utf32:  process_utf_data(*this, *face, addFeatures(*pFeats), utf32::const_iterator(pStart), nChars); break;
+    case gr_utf8:   process_utf_data(*this, *face, fid, utf8::const_iterator(pStart), nChars); break;
+    case gr_utf16:  process_utf_data(*this, *face, fid, utf16::const_iterator(pStart), nChars); break;
+    case gr_utf32:  process_utf_data(*this, *face, fid, utf32::const_iterator(pStart), nChars); break;
     }
     return true;
 }
@@ -412,7 +543,8 @@ void Segment::doMirror(uint16 aMirror)
 
 bool Segment::initCollisions()
 {
-    m_collisions = grzeroalloc<SlotCollision>(slotCount());
+    invalidatePositions();
+    m_collisions = m_arena->zeroalloc<SlotCollision>(slotCount());
     if (!m_collisions) return false;
 
     for (Slot *p = m_first; p; p = p->next())
@@ -0,0 +1,240 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2026, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#include <cstdint>
+#include <cstring>
+#include "inc/CmapCache.h"
+#include "inc/Face.h"
+#include "inc/GlyphCache.h"
+#include "inc/NameTable.h"
+#include "inc/SharedFace.h"
+#include "inc/Silf.h"
+
+#if !defined GRAPHITE2_NTHREADS
+#include <pthread.h>
+#endif
+
+using namespace graphite2;
+
+namespace
+{
+    SharedFace    * s_registry = 0;
+#if !defined GRAPHITE2_NTHREADS
+    pthread_mutex_t s_registryLock = PTHREAD_MUTEX_INITIALIZER;
+
+    struct RegistryLock
+    {
+        RegistryLock()  { pthread_mutex_lock(&s_registryLock); }
+        ~RegistryLock() { pthread_mutex_unlock(&s_registryLock); }
+    };
+#else
+    // Faces never share tables in these builds, see load_face(), so nothing
+    // takes this.
+    struct RegistryLock { RegistryLock() {} };
+#endif
+
+    // Every table loading a face reads from.
+    const uint32 shared_tables[] = {
+        Tag::Silf, Tag::Feat, Tag::Sill, Tag::Glat, Tag::Gloc, Tag::cmap,
+        Tag::head, Tag::hhea, Tag::hmtx, Tag::maxp, Tag::glyf, Tag::loca,
+        Tag::name
+    };
+
+    // What a font's content key records of each table.
+    struct TableDigest
+    {
+        uint32      tag,
+                    size;
+        uint64_t    hash;
+    };
+
+    enum key_kind { CONTENT, APP_ID };
+
+    // A 64 bit multiply and shift hash, after MurmurHash64A. It tells
+    // different fonts apart but is not cryptographic.
+    uint64_t hash(const byte * p, size_t n, uint64_t h)
+    {
+        const uint64_t m = 0xc6a4a7935bd1e995ULL;
+        h ^= n * m;
+        for (const byte * const e = p + (n & ~size_t(7)); p != e; p += 8)
+        {
+            uint64_t k;
+            memcpy(&k, p, sizeof k);
+            k *= m; k ^= k >> 47; k *= m;
+            h ^= k; h *= m;
+        }
+        if (n & 7)
+        {
+            uint64_t k = 0;
+            memcpy(&k, p, n & 7);
+            h ^= k; h *= m;
+        }
+        h ^= h >> 47; h *= m; h ^= h >> 47;
+        return h;
+    }
+
+    byte * make_key(const Face & face, const void * id, size_t id_length, size_t & key_length)
+    {
+        const size_t num_tables = sizeof shared_tables / sizeof *shared_tables;
+        key_length = 1 + (id ? id_length : num_tables * sizeof(TableDigest));
+        if (id && id_length > ~size_t(0) - 1) return 0;
+        byte * const key = gralloc<byte>(key_length);
+        if (!key) return 0;
+
+        if (id)
+        {
+            key[0] = APP_ID;
+            memcpy(key + 1, id, id_length);
+            return key;
+        }
+
+        key[0] = CONTENT;
+        for (size_t i = 0; i != num_tables; ++i)
+        {
+            const Face::Table t(face, shared_tables[i]);
+            TableDigest d = { shared_tables[i], uint32(t.size()), hash(t, t.size(), shared_tables[i]) };
+            memcpy(key + 1 + i * sizeof d, &d, sizeof d);
+        }
+        return key;
+    }
+}
+
+
+SharedFace::SharedFace(const Face & face, byte * key, size_t key_length) throw()
+: m_glyphs(0),
+  m_cmap(0),
+  m_demandGlyphs(0),
+  m_demandCmap(0),
+  m_names(0),
+  m_silfs(0),
+  m_loader(&face),
+  m_next(0),
+  m_key(key),
+  m_keyLength(key_length),
+  m_refs(1),
+  m_preloaded(false),
+  m_numSilf(0),
+  m_registered(false)
+{
+}
+
+SharedFace::~SharedFace() throw()
+{
+    delete m_glyphs.load();
+    delete m_cmap.load();
+    delete m_demandGlyphs;
+    delete m_demandCmap;
+    delete[] m_silfs;
+    delete m_names;
+    grfree(m_key);
+}
+
+SharedFace * SharedFace::lookup(const Face & face, const void * id, size_t id_length)
+{
+    size_t key_length;
+    byte * const key = make_key(face, id, id_length, key_length);
+    if (!key) return 0;
+
+    {
+        RegistryLock lock;
+        for (SharedFace * s = s_registry; s; s = s->m_next)
+            if (s->m_keyLength == key_length && memcmp(s->m_key, key, key_length) == 0)
+            {
+                ++s->m_refs;
+                grfree(key);
+                return s;
+            }
+    }
+
+    SharedFace * const res = new SharedFace(face, key, key_length);
+    if (!res) grfree(key);
+    return res;
+}
+
+bool SharedFace::shareable() const throw()
+{
+    // Tables still read from the font on demand tie these to the face that
+    // loaded them.
+    return m_key && loaded() && m_glyphs.load()->preloaded();
+}
+
+SharedFace * SharedFace::publish()
+{
+    if (!shareable()) return this;
+
+    RegistryLock lock;
+    for (SharedFace * s = s_registry; s; s = s->m_next)
+        if (s->m_keyLength == m_keyLength && memcmp(s->m_key, m_key, m_keyLength) == 0)
+        {
+            ++s->m_refs;
+            delete this;
+            return s;
+        }
+
+    m_loader = 0;
+    m_next = s_registry;
+    s_registry = this;
+    m_registered = true;
+    return this;
+}
+
+void SharedFace::release()
+{
+    if (m_registered)
+    {
+        RegistryLock lock;
+        if (--m_refs != 0) return;
+        SharedFace ** p = &s_registry;
+        while (*p != this) p = &(*p)->m_next;
+        *p = m_next;
+    }
+    delete this;
+}
+
+void SharedFace::preload()
+{
+    GlyphCache * const glyphs = m_glyphs.load()->preload();
+    Cmap * const cmap = new CachedCmap(*static_cast<const DirectCmap *>(m_cmap.load()));
+    if (!glyphs || !cmap || !*cmap)
+    {
+        delete glyphs;
+        delete cmap;
+        return;
+    }
+
+    m_demandGlyphs = m_glyphs.exchange(glyphs, std::memory_order_acq_rel);
+    m_demandCmap = m_cmap.exchange(cmap, std::memory_order_acq_rel);
+    m_preloaded.store(true, std::memory_order_release);
+}
+
+NameTable * SharedFace::nameTable() const
+{
+    if (m_names || !m_loader) return m_names;
+    const Face::Table name(*m_loader, Tag::name);
+    if (name)
+        m_names = new NameTable(name, name.size());
+    return m_names;
+}
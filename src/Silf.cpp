@@ -31,6 +31,7 @@ of the License or (at your option) any later version.
 #include "inc/Silf.h"
 #include "inc/Segment.h"
 #include "inc/Rule.h"
+#include "inc/ShapingContext.h"
 #include "inc/Error.h"
 
 
@@ -44,6 +45,8 @@ Silf::Silf() throw()
   m_classOffsets(0),
   m_classData(0),
   m_justs(0),
+  m_progs(0),
+  m_inert(0),
   m_numPasses(0),
   m_numJusts(0),
   m_sPass(0),
@@ -64,7 +67,8 @@ Silf::Silf() throw()
   m_numPseudo(0),
   m_nClass(0),
   m_nLinear(0),
-  m_gEndLine(0)
+  m_gEndLine(0),
+  m_numInert(0)
 {
     memset(&m_silfinfo, 0, sizeof m_silfinfo);
 }
@@ -78,14 +82,18 @@ void Silf::releaseBuffers() throw()
 {
     delete [] m_passes;
     delete [] m_pseudos;
-    free(m_classOffsets);
-    free(m_classData);
-    free(m_justs);
+    grfree(m_classOffsets);
+    grfree(m_classData);
+    grfree(m_justs);
+    grfree(m_progs);
+    grfree(m_inert);
     m_passes= 0;
     m_pseudos = 0;
     m_classOffsets = 0;
     m_classData = 0;
     m_justs = 0;
+    m_progs = 0;
+    m_inert = 0;
 }
 
 
@@ -221,6 +229,41 @@ bool Silf::readGraphite(const byte * const silf_start, size_t lSilf, Face& face,
         }
     }
 
+    // Gather the code for every pass into one contiguous allocation, laid
+    // out in execution order. Nothing writes to it once it is packed.
+    size_t prog_sz = 0;
+    for (size_t i = 0; i < m_numPasses; ++i)
+        prog_sz += m_passes[i].programSize();
+    if (prog_sz)
+    {
+        m_progs = gralloc<byte>(prog_sz);
+        if (e.test(!m_progs, E_OUTOFMEM)) { releaseBuffers(); return face.error(e); }
+    }
+    byte * prog_out = m_progs;
+    for (size_t i = 0; i < m_numPasses; ++i)
+        m_passes[i].packPrograms(prog_out);
+    assert(prog_out == m_progs + prog_sz);
+
+    // Find the glyphs that no pass's FSM has a column for.  A segment made
+    // only of those can never match a rule, and if no pass does anything
+    // else either runGraphite need not run the passes at all.
+    bool skippable = true;
+    for (size_t i = 0; i < m_numPasses; ++i)
+        skippable &= !m_passes[i].hasSideEffects();
+    if (skippable)
+    {
+        m_numInert = face.glyphs().numGlyphs();
+        m_inert = grzeroalloc<uint32>((m_numInert + 31) >> 5);
+        if (e.test(!m_inert, E_OUTOFMEM)) { releaseBuffers(); return face.error(e); }
+        for (uint16 gid = 0; gid != m_numInert; ++gid)
+        {
+            size_t i = 0;
+            while (i != m_numPasses && m_passes[i].ignoresGlyph(gid)) ++i;
+            if (i == m_numPasses)
+                m_inert[gid >> 5] |= uint32(1) << (gid & 31);
+        }
+    }
+
     // fill in gr_faceinfo
     m_silfinfo.upem = face.glyphs().unitsPerEm();
     m_silfinfo.has_bidi_pass = (m_bPass != 0xFF);
@@ -357,13 +400,32 @@ uint16 Silf::getClassGlyph(uint16 cid, unsigned int index) const
 bool Silf::runGraphite(Segment *seg, uint8 firstPass, uint8 lastPass, int dobidi) const
 {
     assert(seg != 0);
-    size_t             maxSize = seg->slotCount() * MAX_SEG_GROWTH_FACTOR;
+    const size_t maxSize = seg->slotCount() * MAX_SEG_GROWTH_FACTOR;
+    ShapingContext * const ctx = seg->context();
+    if (ctx)
+    {
+        // Build the (large) slot map, rule buffer and stack in the caller's
+        // storage rather than on our stack.
+        SlotMap & map = *new (ctx->slotMap()) SlotMap(*seg, m_dir, maxSize);
+        FiniteStateMachine & fsm = *new (ctx->fsm()) FiniteStateMachine(map, seg->getFace()->logger());
+        vm::Machine & m = *new (ctx->machine()) vm::Machine(map);
+        return runPasses(seg, m, fsm, maxSize, firstPass, lastPass, dobidi);
+    }
+
     SlotMap            map(*seg, m_dir, maxSize);
     FiniteStateMachine fsm(map, seg->getFace()->logger());
     vm::Machine        m(map);
+    return runPasses(seg, m, fsm, maxSize, firstPass, lastPass, dobidi);
+}
+
+bool Silf::runPasses(Segment *seg, vm::Machine &m, FiniteStateMachine &fsm, size_t maxSize, uint8 firstPass, uint8 lastPass, int dobidi) const
+{
     uint8              lbidi = m_bPass;
 #if !defined GRAPHITE2_NTRACING
     json * const dbgout = seg->getFace()->logger();
+    const bool mayskip = !dbgout;
+#else
+    const bool mayskip = true;
 #endif
 
     if (lastPass == 0)
@@ -399,10 +461,15 @@ bool Silf::runGraphite(Segment *seg, uint8 firstPass, uint8 lastPass, int dobidi
                             << json::close;
             }
 #endif
-            if (seg->currdir() != (m_dir & 1))
-                seg->reverseSlots();
-            if (m_aMirror && (seg->dir() & 3) == 3)
-                seg->doMirror(m_aMirror);
+            if ((seg->dir() & 10) == 8)     // gr_fullbidi without gr_nobidi
+                seg->bidiPass(seg->dir() & 1, m_aMirror);
+            else
+            {
+                if (seg->currdir() != (m_dir & 1))
+                    seg->reverseSlots();
+                if (m_aMirror && (seg->dir() & 3) == 3)
+                    seg->doMirror(m_aMirror);
+            }
         --i;
         lbidi = lastPass;
         --lastPass;
@@ -427,9 +494,21 @@ bool Silf::runGraphite(Segment *seg, uint8 firstPass, uint8 lastPass, int dobidi
 
         // test whether to reorder, prepare for positioning
         bool reverse = (lbidi == 0xFF) && (seg->currdir() != ((m_dir & 1) ^ m_passes[i].reverseDir()));
-        if ((i >= 32 || (seg->passBits() & (1 << i)) == 0 || m_passes[i].collisionLoops())
-                && !m_passes[i].runGraphite(m, fsm, reverse))
-            return false;
+        if (i >= 32 || (seg->passBits() & (1 << i)) == 0 || m_passes[i].collisionLoops())
+        {
+            // No rule can match, so just leave the slots in the order the
+            // pass would have.  The flag is read afresh for every pass since
+            // the bidi pass, or anything between calls such as justification
+            // adding a line end, can bring in glyphs the passes do match.
+            if (mayskip && (seg->flags() & Segment::SEG_INERT))
+            {
+                if (reverse && seg->first())
+                    seg->reverseSlots();
+                continue;
+            }
+            if (!m_passes[i].runGraphite(m, fsm, reverse))
+                return false;
+        }
         // only subsitution passes can change segment length, cached subsegments are short for their text
         if (m.status() != vm::Machine::finished
             || (seg->slotCount() && seg->slotCount() > maxSize))
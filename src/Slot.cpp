@@ -39,7 +39,7 @@ Slot::Slot(int16 *user_attrs) :
     m_glyphid(0), m_realglyphid(0), m_original(0), m_before(0), m_after(0),
     m_index(0), m_parent(NULL), m_child(NULL), m_sibling(NULL),
     m_position(0, 0), m_shift(0, 0), m_advance(0, 0),
-    m_attach(0, 0), m_with(0, 0), m_just(0.),
+    m_attach(0, 0), m_with(0, 0), m_layoutBase(0, 0), m_layoutEnd(0, 0), m_just(0.),
     m_flags(0), m_attLevel(0), m_bidiCls(-1), m_bidiLevel(0),
     m_userAttr(user_attrs), m_justs(NULL)
 {
@@ -68,14 +68,14 @@ void Slot::set(const Slot & orig, int charOffset, size_t sizeAttr, size_t justLe
     m_advance = orig.m_advance;
     m_attach = orig.m_attach;
     m_with = orig.m_with;
-    m_flags = orig.m_flags;
+    m_flags = orig.m_flags & ~POSITIONED;
     m_attLevel = orig.m_attLevel;
     m_bidiCls = orig.m_bidiCls;
     m_bidiLevel = orig.m_bidiLevel;
     if (m_userAttr && orig.m_userAttr)
         memcpy(m_userAttr, orig.m_userAttr, sizeAttr * sizeof(*m_userAttr));
     if (m_justs && orig.m_justs)
-        memcpy(m_justs, orig.m_justs, SlotJustify::size_of(justLevels));
+        memcpy(m_justs->values, orig.m_justs->values, (justLevels > 1 ? justLevels : 1) * SlotJustify::NUMJUSTPARAMS * sizeof(int16));
 }
 
 void Slot::update(int /*numGrSlots*/, int numCharInfo, Position &relpos)
@@ -83,84 +83,164 @@ void Slot::update(int /*numGrSlots*/, int numCharInfo, Position &relpos)
     m_before += numCharInfo;
     m_after += numCharInfo;
     m_position = m_position + relpos;
+    invalidatePosition();
 }
 
-Position Slot::finalise(const Segment *seg, const Font *font, Position & base, Rect & bbox, uint8 attrLevel, float & clusterMin, bool rtl, bool isFinal, int depth)
+namespace
 {
-    SlotCollision *coll = NULL;
-    if (depth > 100 || (attrLevel && m_attLevel > attrLevel)) return Position(0, 0);
-    float scale = font ? font->scale() : 1.0f;
-    Position shift(m_shift.x * (rtl * -2 + 1) + m_just, m_shift.y);
-    float tAdvance = m_advance.x + m_just;
-    if (isFinal && (coll = seg->collisionInfo(this)))
+    // One level of the attachment walk in Slot::finalise.
+    struct FinaliseFrame
     {
-        const Position &collshift = coll->offset();
-        if (!(coll->flags() & SlotCollision::COLL_KERN) || rtl)
-            shift = shift + collshift;
-    }
-    const GlyphFace * glyphFace = seg->getFace()->glyphs().glyphSafe(glyph());
-    if (font)
-    {
-        scale = font->scale();
-        shift *= scale;
-        if (font->isHinted() && glyphFace)
-            tAdvance = (m_advance.x - glyphFace->theAdvance().x + m_just) * scale + font->advance(glyph());
-        else
-            tAdvance *= scale;
-    }
-    Position res;
+        Slot      * slot;
+        Position    base,       // position the slot is placed relative to
+                    res;        // advance of the slot and what has been laid out after it
+        int         state;
+    };
 
-    m_position = base + shift;
-    if (!m_parent)
-    {
-        res = base + Position(tAdvance, m_advance.y * scale);
-        clusterMin = m_position.x;
-    }
-    else
-    {
-        float tAdv;
-        m_position += (m_attach - m_with) * scale;
-        tAdv = m_advance.x >= 0.5f ? m_position.x + tAdvance - shift.x : 0.f;
-        res = Position(tAdv, 0);
-        if ((m_advance.x >= 0.5f || m_position.x < 0) && m_position.x < clusterMin) clusterMin = m_position.x;
-    }
+    enum { MAX_CLUSTER_DEPTH = 100 };
+}
 
-    if (glyphFace)
-    {
-        Rect ourBbox = glyphFace->theBBox() * scale + m_position;
-        bbox = bbox.widen(ourBbox);
-    }
+// Something about this slot changed that affects where it, and so the rest of
+// its cluster, ends up. Clear the base slot's positioned flag so that the next
+// Segment::positionSlots lays the cluster out again.
+void Slot::invalidatePosition()
+{
+    Slot *s = this;
+    for (int depth = 0; s && depth <= MAX_CLUSTER_DEPTH; s = s->m_parent, ++depth)
+        s->markPositioned(false);
+}
 
-    if (m_child && m_child != this && m_child->attachedTo() == this)
+// Lays out a slot, its children and (for attached slots) its following
+// siblings. This walks the attachment tree depth first with an explicit stack
+// rather than recursing, visiting slots in the same order and with the same
+// depth limit as a recursive walk would.
+Position Slot::finalise(const Segment *seg, const Font *font, Position & base, Rect & bbox, uint8 attrLevel, float & clusterMin, bool rtl, bool isFinal)
+{
+    enum { ENTER, AFTER_CHILD, AFTER_SIBLING };
+    FinaliseFrame stack[MAX_CLUSTER_DEPTH + 2];
+    FinaliseFrame * f = stack;
+    const GlyphCache & gc = seg->getFace()->glyphs();
+    const float scale = font ? font->scale() : 1.0f;
+    Position ret;
+
+    f->slot = this;
+    f->base = base;
+    f->state = ENTER;
+    for (;;)
     {
-        Position tRes = m_child->finalise(seg, font, m_position, bbox, attrLevel, clusterMin, rtl, isFinal, depth + 1);
-        if ((!m_parent || m_advance.x >= 0.5f) && tRes.x > res.x) res = tRes;
-    }
+        Slot * const s = f->slot;
+        switch (f->state)
+        {
+        case ENTER:
+        {
+            if (f - stack > MAX_CLUSTER_DEPTH || (attrLevel && s->m_attLevel > attrLevel))
+            {
+                ret = Position(0, 0);
+                break;
+            }
+            Position shift(s->m_shift.x * (rtl * -2 + 1) + s->m_just, s->m_shift.y);
+            float tAdvance = s->m_advance.x + s->m_just;
+            SlotCollision *coll;
+            if (isFinal && (coll = seg->collisionInfo(s)))
+            {
+                const Position &collshift = coll->offset();
+                if (!(coll->flags() & SlotCollision::COLL_KERN) || rtl)
+                    shift = shift + collshift;
+            }
+            const GlyphFace * glyphFace = gc.glyphSafe(s->glyph());
+            if (font)
+            {
+                shift *= scale;
+                if (font->isHinted() && glyphFace)
+                    tAdvance = (s->m_advance.x - glyphFace->theAdvance().x + s->m_just) * scale + font->advance(s->glyph());
+                else
+                    tAdvance *= scale;
+            }
 
-    if (m_parent && m_sibling && m_sibling != this && m_sibling->attachedTo() == m_parent)
-    {
-        Position tRes = m_sibling->finalise(seg, font, base, bbox, attrLevel, clusterMin, rtl, isFinal, depth + 1);
-        if (tRes.x > res.x) res = tRes;
-    }
+            s->m_position = f->base + shift;
+            if (!s->m_parent)
+            {
+                f->res = f->base + Position(tAdvance, s->m_advance.y * scale);
+                clusterMin = s->m_position.x;
+            }
+            else
+            {
+                s->m_position += (s->m_attach - s->m_with) * scale;
+                f->res = Position(s->m_advance.x >= 0.5f ? s->m_position.x + tAdvance - shift.x : 0.f, 0);
+                if ((s->m_advance.x >= 0.5f || s->m_position.x < 0) && s->m_position.x < clusterMin) clusterMin = s->m_position.x;
+            }
+            if (glyphFace)
+            {
+                Rect ourBbox = glyphFace->theBBox() * scale + s->m_position;
+                bbox = bbox.widen(ourBbox);
+            }
 
-    if (!m_parent && clusterMin < base.x)
-    {
-        Position adj = Position(m_position.x - clusterMin, 0.);
-        res += adj;
-        m_position += adj;
-        if (m_child) m_child->floodShift(adj);
+            if (s->m_child && s->m_child != s && s->m_child->attachedTo() == s)
+            {
+                f->state = AFTER_CHILD;
+                f[1].slot = s->m_child;
+                f[1].base = s->m_position;
+                f[1].state = ENTER;
+                ++f;
+                continue;
+            }
+            ret = f->res;
+            GR_FALLTHROUGH;
+        }
+        case AFTER_CHILD:
+            if ((!s->m_parent || s->m_advance.x >= 0.5f) && ret.x > f->res.x) f->res = ret;
+            if (s->m_parent && s->m_sibling && s->m_sibling != s && s->m_sibling->attachedTo() == s->m_parent)
+            {
+                f->state = AFTER_SIBLING;
+                f[1].slot = s->m_sibling;
+                f[1].base = f->base;
+                f[1].state = ENTER;
+                ++f;
+                continue;
+            }
+            ret = f->res;
+            GR_FALLTHROUGH;
+        case AFTER_SIBLING:
+            if (ret.x > f->res.x) f->res = ret;
+            if (!s->m_parent && clusterMin < f->base.x)
+            {
+                Position adj = Position(s->m_position.x - clusterMin, 0.);
+                f->res += adj;
+                s->m_position += adj;
+                if (s->m_child) s->m_child->floodShift(adj);
+            }
+            ret = f->res;
+            break;
+        }
+
+        // This slot is done, hand its result back to whoever pushed it.
+        if (f == stack)
+            return ret;
+        --f;
     }
-    return res;
 }
 
 int32 Slot::clusterMetric(const Segment *seg, uint8 metric, uint8 attrLevel, bool rtl)
 {
-    Position base;
     if (glyph() >= seg->getFace()->glyphs().numGlyphs())
         return 0;
-    Rect bbox = seg->theGlyphBBoxTemporary(glyph());
-    float clusterMin = 0.;
-    Position res = finalise(seg, NULL, base, bbox, attrLevel, clusterMin, rtl, false);
+
+    // Rules tend to ask for several metrics of the same cluster in a row, so
+    // the last layout is kept until something that could change it happens.
+    Segment::ClusterCache & cache = seg->clusterCache();
+    if (cache.slot != this || cache.attrLevel != attrLevel || cache.rtl != rtl)
+    {
+        Position base;
+        float clusterMin = 0.;
+        cache.bbox = seg->theGlyphBBoxTemporary(glyph());
+        cache.advance = finalise(seg, NULL, base, cache.bbox, attrLevel, clusterMin, rtl, false);
+        invalidatePosition();   // the cluster now sits at the origin
+        cache.slot = this;
+        cache.attrLevel = attrLevel;
+        cache.rtl = rtl;
+    }
+    const Rect & bbox = cache.bbox;
+    const Position & res = cache.advance;
 
     switch (metrics(metric))
     {
@@ -280,12 +360,14 @@ void Slot::setAttr(Segment *seg, attrCode ind, uint8 subindex, int16 value, cons
         return setJustify(seg, indx / 5, indx % 5, value);
     }
 
+    seg->invalidateClusterCache();
     switch (ind)
     {
-    case gr_slatAdvX :  m_advance.x = value; break;
-    case gr_slatAdvY :  m_advance.y = value; break;
+    case gr_slatAdvX :  m_advance.x = value; invalidatePosition(); break;
+    case gr_slatAdvY :  m_advance.y = value; invalidatePosition(); break;
     case gr_slatAttTo :
     {
+        invalidatePosition();
         const uint16 idx = uint16(value);
         if (idx < map.size() && map[idx])
         {
@@ -312,20 +394,22 @@ void Slot::setAttr(Segment *seg, attrCode ind, uint8 subindex, int16 value, cons
                     m_with = Position(advance(), 0);
                 else        // normal match to previous root
                     m_attach = Position(other->advance(), 0);
+                invalidatePosition();
             }
         }
         break;
     }
-    case gr_slatAttX :          m_attach.x = value; break;
-    case gr_slatAttY :          m_attach.y = value; break;
+    case gr_slatAttX :          m_attach.x = value; invalidatePosition(); break;
+    case gr_slatAttY :          m_attach.y = value; invalidatePosition(); break;
     case gr_slatAttXOff :
     case gr_slatAttYOff :       break;
-    case gr_slatAttWithX :      m_with.x = value; break;
-    case gr_slatAttWithY :      m_with.y = value; break;
+    case gr_slatAttWithX :      m_with.x = value; invalidatePosition(); break;
+    case gr_slatAttWithY :      m_with.y = value; invalidatePosition(); break;
     case gr_slatAttWithXOff :
     case gr_slatAttWithYOff :   break;
     case gr_slatAttLevel :
         m_attLevel = byte(value);
+        invalidatePosition();
         break;
     case gr_slatBreak :
         seg->charinfo(m_original)->breakWeight(value);
@@ -337,8 +421,8 @@ void Slot::setAttr(Segment *seg, attrCode ind, uint8 subindex, int16 value, cons
         break;
     case gr_slatPosX :      break; // can't set these here
     case gr_slatPosY :      break;
-    case gr_slatShiftX :    m_shift.x = value; break;
-    case gr_slatShiftY :    m_shift.y = value; break;
+    case gr_slatShiftX :    m_shift.x = value; invalidatePosition(); break;
+    case gr_slatShiftY :    m_shift.y = value; invalidatePosition(); break;
     case gr_slatMeasureSol :    break;
     case gr_slatMeasureEol :    break;
     case gr_slatJWidth :    just(value); break;
@@ -348,6 +432,7 @@ void Slot::setAttr(Segment *seg, attrCode ind, uint8 subindex, int16 value, cons
         SlotCollision *c = seg->collisionInfo(this);
         if (c)
             c->setFlags(value);
+        invalidatePosition();
         break; }
     case gr_slatColLimitblx :	SLOTCOLSETCOMPLEXATTR(Rect, limit(), setLimit(Rect(Position(value, s.bl.y), s.tr)))
     case gr_slatColLimitbly :	SLOTCOLSETCOMPLEXATTR(Rect, limit(), setLimit(Rect(Position(s.bl.x, value), s.tr)))
@@ -395,16 +480,33 @@ int Slot::getJustify(const Segment *seg, uint8 level, uint8 subindex) const
 void Slot::setJustify(Segment *seg, uint8 level, uint8 subindex, int16 value)
 {
     if (level && level >= seg->silf()->numJustLevels()) return;
-    if (!m_justs)
+    if (!m_justs || m_justs->refs > 1)
     {
+        // Copied slots share their justification values until one of them
+        // writes to them.
         SlotJustify *j = seg->newJustify();
         if (!j) return;
-        j->LoadSlot(this, seg);
+        if (m_justs)
+        {
+            const int levels = seg->silf()->numJustLevels();
+            memcpy(j->values, m_justs->values, (levels > 1 ? levels : 1) * SlotJustify::NUMJUSTPARAMS * sizeof(int16));
+            --m_justs->refs;
+        }
+        else
+            j->LoadSlot(this, seg);
         m_justs = j;
     }
     m_justs->values[level * SlotJustify::NUMJUSTPARAMS + subindex] = value;
 }
 
+void Slot::releaseJustify(Segment *seg)
+{
+    // The last slot using a block gives it back to the segment.
+    if (m_justs && --m_justs->refs == 0)
+        seg->freeJustify(m_justs);
+    m_justs = NULL;
+}
+
 bool Slot::child(Slot *ap)
 {
     if (this == ap) return false;
@@ -451,8 +553,13 @@ bool Slot::removeChild(Slot *ap)
 
 void Slot::setGlyph(Segment *seg, uint16 glyphid, const GlyphFace * theGlyph)
 {
+    seg->invalidateClusterCache();
+    invalidatePosition();
     m_glyphid = glyphid;
     m_bidiCls = -1;
+    // Any glyph a pass could match means the segment's passes must run.
+    if (!seg->silf()->inertGlyph(glyphid))
+        seg->flags(seg->flags() & ~Segment::SEG_INERT);
     if (!theGlyph)
     {
         theGlyph = seg->getFace()->glyphs().glyphSafe(glyphid);
@@ -481,13 +588,32 @@ void Slot::setGlyph(Segment *seg, uint16 glyphid, const GlyphFace * theGlyph)
     }
 }
 
-void Slot::floodShift(Position adj, int depth)
+void Slot::floodShift(Position adj)
 {
-    if (depth > 100)
-        return;
-    m_position += adj;
-    if (m_child) m_child->floodShift(adj, depth + 1);
-    if (m_sibling) m_sibling->floodShift(adj, depth + 1);
+    struct { Slot * slot; int depth; } pending[MAX_CLUSTER_DEPTH + 2];
+    int n = 0;
+
+    pending[n].slot = this;
+    pending[n++].depth = 0;
+    while (n)
+    {
+        --n;
+        Slot * const s = pending[n].slot;
+        const int depth = pending[n].depth;
+        if (depth > MAX_CLUSTER_DEPTH)
+            continue;
+        s->m_position += adj;
+        if (s->m_sibling)
+        {
+            pending[n].slot = s->m_sibling;
+            pending[n++].depth = depth + 1;
+        }
+        if (s->m_child)
+        {
+            pending[n].slot = s->m_child;
+            pending[n++].depth = depth + 1;
+        }
+    }
 }
 
 void SlotJustify::LoadSlot(const Slot *s, const Segment *seg)
@@ -35,7 +35,7 @@ const sparse::chunk sparse::empty_chunk = {0,0};
 sparse::~sparse() throw()
 {
     if (m_array.map == &empty_chunk) return;
-    free(m_array.values);
+    grfree(m_array.values);
 }
 
 
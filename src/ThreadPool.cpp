@@ -0,0 +1,164 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#include "inc/ThreadPool.h"
+
+#if !defined GRAPHITE2_NTHREADS
+#include <unistd.h>
+#endif
+
+using namespace graphite2;
+
+namespace
+{
+    // Beyond this the per segment work is too small to keep more threads fed.
+    const size_t MAX_WORKERS = 7;
+}
+
+#if !defined GRAPHITE2_NTHREADS
+
+ThreadPool::ThreadPool(size_t num_workers)
+: m_threads(num_workers ? gralloc<pthread_t>(num_workers) : 0),
+  m_fn(0), m_ctx(0), m_memory(0),
+  m_next(0), m_end(0), m_pending(0),
+  m_generation(0),
+  m_quit(false),
+  m_numWorkers(0)
+{
+    pthread_mutex_init(&m_lock, 0);
+    pthread_mutex_init(&m_busy, 0);
+    pthread_cond_init(&m_wake, 0);
+    pthread_cond_init(&m_done, 0);
+
+    if (!m_threads) return;
+    for (; m_numWorkers != num_workers; ++m_numWorkers)
+        if (pthread_create(m_threads + m_numWorkers, 0, &ThreadPool::worker, this) != 0)
+            break;
+}
+
+ThreadPool::~ThreadPool()
+{
+    pthread_mutex_lock(&m_lock);
+    m_quit = true;
+    pthread_cond_broadcast(&m_wake);
+    pthread_mutex_unlock(&m_lock);
+
+    for (size_t i = 0; i != m_numWorkers; ++i)
+        pthread_join(m_threads[i], 0);
+    grfree(m_threads);
+
+    pthread_cond_destroy(&m_done);
+    pthread_cond_destroy(&m_wake);
+    pthread_mutex_destroy(&m_busy);
+    pthread_mutex_destroy(&m_lock);
+}
+
+size_t ThreadPool::default_workers()
+{
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 1 ? min(size_t(n - 1), MAX_WORKERS) : 0;
+}
+
+// Must be called with m_lock held, returns with it held.
+void ThreadPool::drain()
+{
+    while (m_next != m_end)
+    {
+        const size_t i = m_next++;
+        pthread_mutex_unlock(&m_lock);
+        m_fn(m_ctx, i);
+        pthread_mutex_lock(&m_lock);
+        if (--m_pending == 0)
+            pthread_cond_broadcast(&m_done);
+    }
+}
+
+void * ThreadPool::worker(void * p)
+{
+    ThreadPool & pool = *static_cast<ThreadPool *>(p);
+    unsigned int seen = 0;
+
+    pthread_mutex_lock(&pool.m_lock);
+    for (;;)
+    {
+        while (!pool.m_quit && pool.m_generation == seen)
+            pthread_cond_wait(&pool.m_wake, &pool.m_lock);
+        if (pool.m_quit) break;
+        seen = pool.m_generation;
+        MemoryScope scope(pool.m_memory);
+        pool.drain();
+    }
+    pthread_mutex_unlock(&pool.m_lock);
+    return 0;
+}
+
+bool ThreadPool::run(task_fn fn, void * ctx, size_t n)
+{
+    if (pthread_mutex_trylock(&m_busy) != 0)
+        return false;
+
+    pthread_mutex_lock(&m_lock);
+    m_fn = fn;
+    m_ctx = ctx;
+    m_memory = MemoryScope::current() ? MemoryScope::current()->stats() : 0;
+    m_next = 0;
+    m_end = m_pending = n;
+    ++m_generation;
+    pthread_cond_broadcast(&m_wake);
+
+    drain();
+    while (m_pending)
+        pthread_cond_wait(&m_done, &m_lock);
+    pthread_mutex_unlock(&m_lock);
+
+    pthread_mutex_unlock(&m_busy);
+    return true;
+}
+
+#else
+
+ThreadPool::ThreadPool(size_t)
+: m_numWorkers(0)
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+}
+
+size_t ThreadPool::default_workers()
+{
+    return 0;
+}
+
+bool ThreadPool::run(task_fn fn, void * ctx, size_t n)
+{
+    for (size_t i = 0; i != n; ++i)
+        fn(ctx, i);
+    return true;
+}
+
+#endif
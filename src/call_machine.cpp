@@ -105,9 +105,12 @@ namespace {
 
 Machine::stack_t  Machine::run(const instr   * program,
                                const byte    * data,
-                               slotref     * & map)
-
+                               slotref     * & map,
+                               bool            /*checked*/)
 {
+    // Instructions return to the dispatch loop anyway so there is no
+    // unchecked variant here, verified programs run the same code.
+
     assert(program != 0);
 
     // Declare virtual machine registers
@@ -132,7 +135,7 @@ namespace {
 #include "inc/opcode_table.h"
 }
 
-const opcode_t * Machine::getOpcodeTable() throw()
+const opcode_t * Machine::getOpcodeTable(bool /*checked*/) throw()
 {
     return opcode_table;
 }
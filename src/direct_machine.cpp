@@ -45,7 +45,7 @@ of the License or (at your option) any later version.
 #include "inc/Rule.h"
 
 #define STARTOP(name)           name: {
-#define ENDOP                   }; goto *((sp - sb)/Machine::STACK_MAX ? &&end : *++ip);
+#define ENDOP                   }; goto *(checked && (sp - sb)/Machine::STACK_MAX ? &&end : *++ip);
 #define EXIT(status)            { push(status); goto end; }
 
 #define do_(name)               &&name
@@ -56,6 +56,9 @@ using namespace vm;
 
 namespace {
 
+// Programs whose stack use the loader has proven to stay in bounds run
+// through the unchecked instantiation, which dispatches with a plain goto.
+template <bool checked>
 const void * direct_run(const bool          get_table_mode,
                         const instr       * program,
                         const byte        * data,
@@ -98,22 +101,26 @@ const void * direct_run(const bool          get_table_mode,
 
 }
 
-const opcode_t * Machine::getOpcodeTable() throw()
+const opcode_t * Machine::getOpcodeTable(bool checked) throw()
 {
     slotref * dummy;
     Machine::status_t dumstat = Machine::finished;
-    return static_cast<const opcode_t *>(direct_run(true, 0, 0, 0, dummy, 0, dumstat));
+    return static_cast<const opcode_t *>(checked
+            ? direct_run<true>(true, 0, 0, 0, dummy, 0, dumstat)
+            : direct_run<false>(true, 0, 0, 0, dummy, 0, dumstat));
 }
 
 
 Machine::stack_t  Machine::run(const instr   * program,
                                const byte    * data,
-                               slotref     * & is)
+                               slotref     * & is,
+                               bool            checked)
 {
     assert(program != 0);
 
-    const stack_t *sp = static_cast<const stack_t *>(
-                direct_run(false, program, data, _stack, is, _map.dir(), _status, &_map));
+    const stack_t *sp = static_cast<const stack_t *>(checked
+            ? direct_run<true>(false, program, data, _stack, is, _map.dir(), _status, &_map)
+            : direct_run<false>(false, program, data, _stack, is, _map.dir(), _status, &_map));
     const stack_t ret = sp == _stack+STACK_GUARD+1 ? *sp-- : 0;
     check_final_stack(sp);
     return ret;
@@ -48,6 +48,7 @@ $(_NS)_SOURCES = \
     $($(_NS)_BASE)/src/gr_slot.cpp \
     $($(_NS)_BASE)/src/json.cpp \
     $($(_NS)_BASE)/src/CachedFace.cpp \
+    $($(_NS)_BASE)/src/Bidi.cpp \
     $($(_NS)_BASE)/src/CmapCache.cpp \
     $($(_NS)_BASE)/src/Code.cpp \
     $($(_NS)_BASE)/src/Collider.cpp \
@@ -60,13 +61,17 @@ $(_NS)_SOURCES = \
     $($(_NS)_BASE)/src/GlyphFace.cpp \
     $($(_NS)_BASE)/src/Intervals.cpp \
     $($(_NS)_BASE)/src/Justifier.cpp \
+    $($(_NS)_BASE)/src/LineBreaker.cpp \
+    $($(_NS)_BASE)/src/Memory.cpp \
     $($(_NS)_BASE)/src/NameTable.cpp \
     $($(_NS)_BASE)/src/Pass.cpp \
     $($(_NS)_BASE)/src/Position.cpp \
     $($(_NS)_BASE)/src/Segment.cpp \
+    $($(_NS)_BASE)/src/SharedFace.cpp \
     $($(_NS)_BASE)/src/Silf.cpp \
     $($(_NS)_BASE)/src/Slot.cpp \
     $($(_NS)_BASE)/src/Sparse.cpp \
+    $($(_NS)_BASE)/src/ThreadPool.cpp \
     $($(_NS)_BASE)/src/TtfUtil.cpp \
     $($(_NS)_BASE)/src/UtfCodec.cpp
 
@@ -95,6 +100,7 @@ $(_NS)_PRIVATE_HEADERS = \
     $($(_NS)_BASE)/src/inc/locale2lcid.h \
     $($(_NS)_BASE)/src/inc/Machine.h \
     $($(_NS)_BASE)/src/inc/Main.h \
+    $($(_NS)_BASE)/src/inc/Memory.h \
     $($(_NS)_BASE)/src/inc/NameTable.h \
     $($(_NS)_BASE)/src/inc/opcode_table.h \
     $($(_NS)_BASE)/src/inc/opcodes.h \
@@ -102,9 +108,12 @@ $(_NS)_PRIVATE_HEADERS = \
     $($(_NS)_BASE)/src/inc/Position.h \
     $($(_NS)_BASE)/src/inc/Rule.h \
     $($(_NS)_BASE)/src/inc/Segment.h \
+    $($(_NS)_BASE)/src/inc/SharedFace.h \
+    $($(_NS)_BASE)/src/inc/ShapingContext.h \
     $($(_NS)_BASE)/src/inc/Silf.h \
     $($(_NS)_BASE)/src/inc/Slot.h \
     $($(_NS)_BASE)/src/inc/Sparse.h \
+    $($(_NS)_BASE)/src/inc/ThreadPool.h \
     $($(_NS)_BASE)/src/inc/TtfTypes.h \
     $($(_NS)_BASE)/src/inc/TtfUtil.h \
     $($(_NS)_BASE)/src/inc/UtfCodec.h
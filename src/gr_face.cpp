@@ -30,6 +30,7 @@ of the License or (at your option) any later version.
 #include "inc/GlyphCache.h"
 #include "inc/CmapCache.h"
 #include "inc/Silf.h"
+#include "inc/ThreadPool.h"
 #include "inc/json.h"
 
 using namespace graphite2;
@@ -40,11 +41,31 @@ extern json *global_log;
 
 namespace
 {
-    bool load_face(Face & face, unsigned int options)
+    bool load_face(Face & face, unsigned int options, const void * id, size_t id_length)
     {
 #ifdef GRAPHITE2_TELEMETRY
         telemetry::category _misc_cat(face.tele.misc);
 #endif
+#if defined GRAPHITE2_NTHREADS
+        // Without a lock to guard the process wide registry faces cannot
+        // share tables, so each loads its own, but otherwise as it would.
+        if (options & gr_face_shareTables)
+            options = (options | gr_face_preloadAll) & ~(gr_face_shareTables | gr_face_preloadAsync);
+#endif
+        if (options & gr_face_shareTables)
+        {
+            if (face.findSharedTables(id, id_length))
+            {
+                if (options & gr_face_parallelCollisions)
+                    face.startThreads(ThreadPool::default_workers());
+                return true;
+            }
+            // Only tables with nothing left to read from the font are shared.
+            options = (options | gr_face_preloadAll) & ~gr_face_preloadAsync;
+        }
+        else if (options & gr_face_preloadAsync)
+            options &= ~gr_face_preloadAll;
+
         Face::Table silf(face, Tag::Silf, 0x00050000);
         if (!silf)
             return false;
@@ -52,6 +73,9 @@ namespace
         if (!face.readGlyphs(options))
             return false;
 
+        if (options & gr_face_parallelCollisions)
+            face.startThreads(ThreadPool::default_workers());
+
         if (silf)
         {
             if (!face.readFeatures() || !face.readGraphite(silf))
@@ -68,13 +92,32 @@ namespace
 #endif
                 return false;
             }
-            else
-                return true;
+            if (options & gr_face_shareTables)
+                face.publishTables();
+            if (options & gr_face_preloadAsync)
+                face.startPreloading();
+            return true;
         }
         else
             return false;
     }
 
+    gr_face * make_face(const void * appFaceHandle, const gr_face_ops * ops,
+                        const void * id, size_t id_length, unsigned int options)
+    {
+        if (ops == 0)   return 0;
+
+        Face *res = new Face(appFaceHandle, *ops);
+        if (!res)   return 0;
+
+        MemoryScope scope(res->memory());
+        if (load_face(*res, options, id, id_length))
+            return static_cast<gr_face *>(res);
+
+        delete res;
+        return 0;
+    }
+
     inline
     uint32 zeropad(const uint32 x)
     {
@@ -91,14 +134,13 @@ extern "C" {
 gr_face* gr_make_face_with_ops(const void* appFaceHandle/*non-NULL*/, const gr_face_ops *ops, unsigned int faceOptions)
                   //the appFaceHandle must stay alive all the time when the gr_face is alive. When finished with the gr_face, call destroy_face
 {
-    if (ops == 0)   return 0;
-
-    Face *res = new Face(appFaceHandle, *ops);
-    if (res && load_face(*res, faceOptions))
-        return static_cast<gr_face *>(res);
+    return make_face(appFaceHandle, ops, NULL, 0, faceOptions);
+}
 
-    delete res;
-    return 0;
+gr_face* gr_make_shared_face_with_ops(const void* appFaceHandle/*non-NULL*/, const gr_face_ops *ops,
+                                      const void *fontId, size_t idLength, unsigned int faceOptions)
+{
+    return make_face(appFaceHandle, ops, fontId, idLength, faceOptions | gr_face_shareTables);
 }
 
 gr_face* gr_make_face(const void* appFaceHandle/*non-NULL*/, gr_get_table_fn tablefn, unsigned int faceOptions)
@@ -201,6 +243,30 @@ gr_uint16 gr_face_name_lang_for_locale(gr_face *face, const char * locale)
     return 0;
 }
 
+size_t gr_face_memory_current(const gr_face *pFace)
+{
+    assert(pFace);
+    return pFace->memory() ? pFace->memory()->current() : 0;
+}
+
+size_t gr_face_memory_peak(const gr_face *pFace)
+{
+    assert(pFace);
+    return pFace->memory() ? pFace->memory()->peak() : 0;
+}
+
+int gr_face_is_preloaded(const gr_face *pFace)
+{
+    assert(pFace);
+    return pFace->preloaded();
+}
+
+int gr_face_wait_preloaded(const gr_face *pFace)
+{
+    assert(pFace);
+    return pFace->waitPreloaded();
+}
+
 unsigned short gr_face_n_glyphs(const gr_face* pFace)
 {
     return pFace->glyphs().numGlyphs();
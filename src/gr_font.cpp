@@ -49,6 +49,7 @@ gr_font* gr_make_font_with_ops(float ppm/*pixels per em*/, const void* appFontHa
 {                 //the appFontHandle must stay alive all the time when the gr_font is alive. When finished with the gr_font, call destroy_gr_font
     if (face == 0 || ppm <= 0)  return 0;
 
+    MemoryScope scope(face->memory());
     Font * const res = new Font(ppm, *face, appFontHandle, font_ops);
     if (*res)
         return static_cast<gr_font*>(res);
@@ -61,7 +62,7 @@ gr_font* gr_make_font_with_ops(float ppm/*pixels per em*/, const void* appFontHa
 
 gr_font* gr_make_font_with_advance_fn(float ppm/*pixels per em*/, const void* appFontHandle/*non-NULL*/, gr_advance_fn getAdvance, const gr_face * face/*needed for scaling*/)
 {
-    const gr_font_ops ops = {sizeof(gr_font_ops), getAdvance, NULL};
+    const gr_font_ops ops = {sizeof(gr_font_ops), getAdvance, NULL, NULL};
     return gr_make_font_with_ops(ppm, appFontHandle, &ops, face);
 }
 
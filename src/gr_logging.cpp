@@ -62,7 +62,7 @@ bool gr_start_logging(GR_MAYBE_UNUSED gr_face * face, const char *log_path)
     if (wlog_path && MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, log_path, -1, wlog_path, n))
         log = _wfopen(wlog_path, L"wt");
 
-    free(wlog_path);
+    grfree(wlog_path);
 #else   // _WIN32
     FILE *log = fopen(log_path, "wt");
 #endif  // _WIN32
@@ -27,28 +27,57 @@ of the License or (at your option) any later version.
 #include "graphite2/Segment.h"
 #include "inc/UtfCodec.h"
 #include "inc/Segment.h"
+#include "inc/ShapingContext.h"
 
 using namespace graphite2;
 
 namespace
 {
 
-  gr_segment* makeAndInitialize(const Font *font, const Face *face, uint32 script, const Features* pFeats/*must not be NULL*/, gr_encform enc, const void* pStart, size_t nChars, int dir)
+  // A segment in a caller's arena lives in it too, and only gives it back
+  // once it is completely gone.
+  void destroy(Segment * seg, Arena * arena)
+  {
+      if (!arena)
+      {
+          delete seg;
+          return;
+      }
+      if (!seg) return;
+      seg->~Segment();
+      arena->release();
+  }
+
+  gr_segment* makeAndInitialize(const Font *font, const Face *face, uint32 script, const Features* pFeats/*must not be NULL*/, gr_encform enc, const void* pStart, size_t nChars, int dir, ShapingContext * ctx = 0, Arena * arena = 0)
   {
       if (script == 0x20202020) script = 0;
       else if ((script & 0x00FFFFFF) == 0x00202020) script = script & 0xFF000000;
       else if ((script & 0x0000FFFF) == 0x00002020) script = script & 0xFFFF0000;
       else if ((script & 0x000000FF) == 0x00000020) script = script & 0xFFFFFF00;
       // if (!font) return NULL;
-      Segment* pRes=new Segment(nChars, face, script, dir);
-
+      AllocCounts allocs;
+      MemoryScope scope(face->memory(), &allocs);
+      Segment* pRes;
+      if (arena)
+      {
+        void * const mem = arena->alloc(sizeof(Segment));
+        if (!mem) return NULL;
+        arena->acquire();
+        pRes = ::new (mem) Segment(nChars, face, script, dir, arena);
+      }
+      else
+        pRes = new Segment(nChars, face, script, dir);
+      if (!pRes) return NULL;
+      pRes->context(ctx);
 
       if (!pRes->read_text(face, pFeats, enc, pStart, nChars) || !pRes->runGraphite())
       {
-        delete pRes;
+        destroy(pRes, arena);
         return NULL;
       }
+      pRes->context(0);
       pRes->finalise(font, true);
+      pRes->allocs(allocs);
 
       return static_cast<gr_segment*>(pRes);
   }
@@ -101,13 +130,49 @@ size_t gr_count_unicode_characters(gr_encform enc, const void* buffer_begin, con
 
 
 gr_segment* gr_make_seg(const gr_font *font, const gr_face *face, gr_uint32 script, const gr_feature_val* pFeats, gr_encform enc, const void* pStart, size_t nChars, int dir)
+{
+    return gr_make_seg_with_context(0, font, face, script, pFeats, enc, pStart, nChars, dir);
+}
+
+
+gr_shaping_context* gr_make_shaping_context()
+{
+    return static_cast<gr_shaping_context*>(new ShapingContext());
+}
+
+
+void gr_shaping_context_destroy(gr_shaping_context* p)
+{
+    delete static_cast<ShapingContext*>(p);
+}
+
+
+gr_segment* gr_make_seg_with_context(gr_shaping_context* ctx, const gr_font *font, const gr_face *face, gr_uint32 script, const gr_feature_val* pFeats, gr_encform enc, const void* pStart, size_t nChars, int dir)
+{
+    return gr_make_seg_in_arena(0, ctx, font, face, script, pFeats, enc, pStart, nChars, dir);
+}
+
+
+gr_segment_arena* gr_make_segment_arena(size_t bytes)
+{
+    return static_cast<gr_segment_arena*>(new Arena(bytes));
+}
+
+
+void gr_segment_arena_destroy(gr_segment_arena* p)
+{
+    delete static_cast<Arena*>(p);
+}
+
+
+gr_segment* gr_make_seg_in_arena(gr_segment_arena* arena, gr_shaping_context* ctx, const gr_font *font, const gr_face *face, gr_uint32 script, const gr_feature_val* pFeats, gr_encform enc, const void* pStart, size_t nChars, int dir)
 {
     if (!face) return nullptr;
 
     const gr_feature_val * tmp_feats = 0;
     if (pFeats == 0)
         pFeats = tmp_feats = static_cast<const gr_feature_val*>(face->theSill().cloneFeatures(0));
-    gr_segment * seg = makeAndInitialize(font, face, script, pFeats, enc, pStart, nChars, dir);
+    gr_segment * seg = makeAndInitialize(font, face, script, pFeats, enc, pStart, nChars, dir, ctx, arena);
     delete static_cast<const FeatureVal*>(tmp_feats);
 
     return seg;
@@ -116,7 +181,7 @@ gr_segment* gr_make_seg(const gr_font *font, const gr_face *face, gr_uint32 scri
 
 void gr_seg_destroy(gr_segment* p)
 {
-    delete static_cast<Segment*>(p);
+    if (p) destroy(p, p->sharedArena());
 }
 
 
@@ -153,6 +218,30 @@ unsigned int gr_seg_n_slots(const gr_segment* pSeg/*not NULL*/)
     return static_cast<unsigned int>(pSeg->slotCount());
 }
 
+size_t gr_seg_n_allocations(const gr_segment* pSeg/*not NULL*/)
+{
+    assert(pSeg);
+    return pSeg->allocs().allocations;
+}
+
+size_t gr_seg_bytes_allocated(const gr_segment* pSeg/*not NULL*/)
+{
+    assert(pSeg);
+    return pSeg->allocs().bytes;
+}
+
+unsigned int gr_seg_slots_high_water(const gr_segment* pSeg/*not NULL*/)
+{
+    assert(pSeg);
+    return static_cast<unsigned int>(pSeg->slotsHighWater());
+}
+
+unsigned int gr_seg_slot_pool_size(const gr_segment* pSeg/*not NULL*/)
+{
+    assert(pSeg);
+    return static_cast<unsigned int>(pSeg->slotPoolSize());
+}
+
 const gr_slot* gr_seg_first_slot(gr_segment* pSeg/*not NULL*/)
 {
     assert(pSeg);
@@ -172,4 +261,16 @@ float gr_seg_justify(gr_segment* pSeg/*not NULL*/, const gr_slot* pSlot/*not NUL
     return pSeg->justify(const_cast<gr_slot *>(pSlot), pFont, float(width), justFlags(flags), const_cast<gr_slot *>(pFirst), const_cast<gr_slot *>(pLast));
 }
 
+void gr_seg_justify_lines(gr_segment* pSeg/*not NULL*/, gr_shaping_context* ctx, const gr_font *pFont, size_t numLines, const gr_slot** pStarts, const float* pWidths, gr_justFlags flags, float* pResults)
+{
+    assert(pSeg);
+    pSeg->justifyLines(ctx, pFont, numLines, const_cast<Slot * const *>(reinterpret_cast<const Slot * const *>(pStarts)), pWidths, justFlags(flags), pResults);
+}
+
+size_t gr_seg_break_lines(const gr_segment* pSeg/*not NULL*/, float width, int maxWeight, gr_linebreak_mode mode, size_t maxLines, const gr_slot** pBreaks, float* pWidths)
+{
+    assert(pSeg);
+    return pSeg->breakLines(width, maxWeight, mode == gr_linebreakTotalFit, maxLines, reinterpret_cast<const Slot **>(pBreaks), pWidths);
+}
+
 } // extern "C"
@@ -58,6 +58,8 @@ public:
 
     CLASS_NEW_DELETE;
 private:
+    friend class CachedCmap;
+
     const Face::Table   _cmap;
     const void        * _smp,
                       * _bmp;
@@ -70,11 +72,15 @@ class CachedCmap : public Cmap
 
 public:
     CachedCmap(const Face &);
+    // Caches the subtables a direct cmap reads, without fetching them again.
+    explicit CachedCmap(const DirectCmap &);
     virtual ~CachedCmap() throw();
     virtual uint16 operator [] (const uint32 usv) const throw();
     virtual operator bool () const throw();
     CLASS_NEW_DELETE;
 private:
+    void cache(const void * bmp_cmap, const void * smp_cmap);
+
     bool m_isBmpOnly;
     uint16 ** m_blocks;
 };
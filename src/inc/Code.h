@@ -32,6 +32,7 @@ of the License or (at your option) any later version.
 #pragma once
 
 #include <cassert>
+#include <cstring>
 #include <graphite2/Types.h>
 #include "inc/Main.h"
 #include "inc/Machine.h"
@@ -79,7 +80,8 @@ private:
     mutable status_t _status;
     bool        _constraint,
                 _modify,
-                _delete;
+                _delete,
+                _verified;
     mutable bool _own;
 
     void release_buffers() throw ();
@@ -103,8 +105,10 @@ public:
     size_t        instructionCount() const throw()  { return _instr_count; }
     bool          immutable() const throw()         { return !(_delete || _modify); }
     bool          deletes() const throw()           { return _delete; }
+    bool          verified() const throw()          { return _verified; }
     size_t        maxRef() const throw()            { return _max_ref; }
-    void          externalProgramMoved(ptrdiff_t) throw();
+    size_t        footprint() const throw();
+    void          relocate(byte * & dest) throw();
 
     int32 run(Machine &m, slotref * & map) const;
 
@@ -123,7 +127,7 @@ size_t  Machine::Code::estimateCodeDataOut(size_t n_bc, int nRules, int nSlots)
 inline Machine::Code::Code() throw()
 : _code(0), _data(0), _data_size(0), _instr_count(0), _max_ref(0),
   _status(loaded), _constraint(false), _modify(false), _delete(false),
-  _own(false)
+  _verified(false), _own(false)
 {
 }
 
@@ -137,6 +141,7 @@ inline Machine::Code::Code(const Machine::Code &obj) throw ()
     _constraint(obj._constraint),
     _modify(obj._modify),
     _delete(obj._delete),
+    _verified(obj._verified),
     _own(obj._own)
 {
     obj._own = false;
@@ -153,18 +158,28 @@ inline Machine::Code & Machine::Code::operator=(const Machine::Code &rhs) throw(
     _constraint  = rhs._constraint;
     _modify      = rhs._modify;
     _delete      = rhs._delete;
+    _verified    = rhs._verified;
     _own         = rhs._own;
     rhs._own = false;
     return *this;
 }
 
-inline void Machine::Code::externalProgramMoved(ptrdiff_t dist) throw()
+inline size_t Machine::Code::footprint() const throw()
 {
-    if (_code && !_own)
-    {
-        _code += dist / signed(sizeof(instr));
-        _data += dist;
-    }
+    return _code ? ((_instr_count+1) + (_data_size + sizeof(instr)-1)/sizeof(instr))*sizeof(instr) : 0;
+}
+
+// Copy the program to dest, which it will then reference but not own, and
+// advance dest past it.
+inline void Machine::Code::relocate(byte * & dest) throw()
+{
+    if (!_code) return;
+    const size_t sz = footprint();
+    memcpy(dest, _code, sz);
+    release_buffers();
+    _code = reinterpret_cast<instr *>(dest);
+    _data = reinterpret_cast<byte *>(_code + (_instr_count+1));
+    dest += sz;
 }
 
 } // namespace vm
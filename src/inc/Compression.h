@@ -58,46 +58,28 @@ void unaligned_copy(void * d, void const * s) {
   ::memcpy(d, s, S);
 }
 
-inline
-size_t align(size_t p) {
-    return (p + sizeof(unsigned long)-1) & ~(sizeof(unsigned long)-1);
-}
-
 inline
 u8 * safe_copy(u8 * d, u8 const * s, size_t n) {
     while (n--) *d++ = *s++;
     return d;
 }
 
+// Copies n bytes S at a time, so up to S-1 bytes past the end of both d
+// and s are touched as well. s may overlap d so long as it is at least S
+// bytes behind it.
+template<size_t S>
 inline
-u8 * overrun_copy(u8 * d, u8 const * s, size_t n) {
-    size_t const WS = sizeof(unsigned long);
-    u8 const * e = s + n;
+u8 * wide_copy(u8 * d, u8 const * s, size_t n) {
+    u8 * const e = d + n;
     do
     {
-        unaligned_copy<WS>(d, s);
-        d += WS;
-        s += WS;
+        unaligned_copy<S>(d, s);
+        d += S;
+        s += S;
     }
-    while (s < e);
-    d-=(s-e);
-
-    return d;
-}
-
+    while (d < e);
 
-inline
-u8 * fast_copy(u8 * d, u8 const * s, size_t n) {
-    size_t const WS = sizeof(unsigned long);
-    size_t wn = n/WS;
-    while (wn--)
-    {
-        unaligned_copy<WS>(d, s);
-        d += WS;
-        s += WS;
-    }
-    n &= WS-1;
-    return safe_copy(d, s, n);
+    return e;
 }
 
 
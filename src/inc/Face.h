@@ -35,6 +35,12 @@ of the License or (at your option) any later version.
 #include "inc/TtfUtil.h"
 #include "inc/Silf.h"
 #include "inc/Error.h"
+#include "inc/Memory.h"
+#include "inc/SharedFace.h"
+
+#if !defined GRAPHITE2_NTHREADS
+#include <pthread.h>
+#endif
 
 namespace graphite2 {
 
@@ -42,6 +48,7 @@ class Cmap;
 class FileFace;
 class GlyphCache;
 class NameTable;
+class ThreadPool;
 class json;
 class Font;
 
@@ -58,7 +65,6 @@ class Face
 
 public:
     class Table;
-    static float default_glyph_advance(const void* face_ptr, gr_uint16 glyphid);
 
     Face(const void* appFaceHandle/*non-NULL*/, const gr_face_ops & ops);
     virtual ~Face();
@@ -69,14 +75,27 @@ public:
     bool                readGlyphs(uint32 faceOptions);
     bool                readGraphite(const Table & silf);
     bool                readFeatures();
+    // Looks for loaded tables to share with other faces of the same font,
+    // returning true if it found them and there is nothing left to read.
+    bool                findSharedTables(const void * id, size_t id_length);
+    void                publishTables();
+    // Preloads the glyphs and cmap, so far loaded on demand, on a thread of
+    // their own, or right away if there is none to be had.
+    void                startPreloading();
+    bool                preloaded() const;
+    bool                waitPreloaded() const;
     void                takeFileFace(FileFace* pFileFace/*takes ownership*/);
 
+    const SharedFace  & shared() const;
     const SillMap     & theSill() const;
     const GlyphCache  & glyphs() const;
     Cmap              & cmap() const;
     NameTable         * nameTable() const;
     void                setLogger(FILE *log_file);
     json              * logger() const throw();
+    void                startThreads(size_t num_workers);
+    ThreadPool        * threads() const throw();
+    MemoryStats       * memory() const throw();
 
     const Silf        * chooseSilf(uint32 script) const;
     uint16              languageForLocale(const char * locale) const;
@@ -98,22 +117,26 @@ public:
 
     CLASS_NEW_DELETE;
 private:
-    SillMap                 m_Sill;
+#if !defined GRAPHITE2_NTHREADS
+    static void           * preloader(void * face);
+#endif
+
     gr_face_ops             m_ops;
     const void            * m_appFaceHandle;    // non-NULL
     FileFace              * m_pFileFace;        //owned
-    mutable GlyphCache    * m_pGlyphFaceCache;  // owned - never NULL
-    mutable Cmap          * m_cmap;             // cmap cache if available
-    mutable NameTable     * m_pNames;
+    SharedFace            * m_shared;           // loaded tables, ours or shared - we hold a reference
     mutable json          * m_logger;
+    ThreadPool            * m_threads;          // owned, NULL unless parallel collisions were requested
+    MemoryStats           * m_memory;           // heap use charged to this face, we hold a reference
     unsigned int            m_error;
     unsigned int            m_errcntxt;
-protected:
-    Silf                  * m_silfs;    // silf subtables.
-    uint16                  m_numSilf;  // num silf subtables in the silf table
-private:
     uint16 m_ascent,
            m_descent;
+#if !defined GRAPHITE2_NTHREADS
+    mutable pthread_mutex_t m_preloadLock;
+    pthread_t               m_preloader;
+    mutable bool            m_preloading;       // m_preloader has yet to be joined
+#endif
 #ifdef GRAPHITE2_TELEMETRY
 public:
     mutable telemetry   tele;
@@ -122,40 +145,46 @@ public:
 
 
 
+inline
+const SharedFace & Face::shared() const
+{
+    return *m_shared;
+}
+
 inline
 const SillMap & Face::theSill() const
 {
-    return m_Sill;
+    return m_shared->theSill();
 }
 
 inline
 uint16 Face::numFeatures() const
 {
-    return m_Sill.theFeatureMap().numFeats();
+    return theSill().theFeatureMap().numFeats();
 }
 
 inline
 const FeatureRef * Face::featureById(uint32 id) const
 {
-    return m_Sill.theFeatureMap().findFeatureRef(id);
+    return theSill().theFeatureMap().findFeatureRef(id);
 }
 
 inline
 const FeatureRef *Face::feature(uint16 index) const
 {
-    return m_Sill.theFeatureMap().feature(index);
+    return theSill().theFeatureMap().feature(index);
 }
 
 inline
 const GlyphCache & Face::glyphs() const
 {
-    return *m_pGlyphFaceCache;
+    return m_shared->glyphs();
 }
 
 inline
 Cmap & Face::cmap() const
 {
-    return *m_cmap;
+    return m_shared->cmap();
 };
 
 inline
@@ -164,6 +193,18 @@ json * Face::logger() const throw()
     return m_logger;
 }
 
+inline
+ThreadPool * Face::threads() const throw()
+{
+    return m_threads;
+}
+
+inline
+MemoryStats * Face::memory() const throw()
+{
+    return m_memory;
+}
+
 
 
 class Face::Table
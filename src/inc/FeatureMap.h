@@ -25,14 +25,20 @@ License, as published by the Free Software Foundation, either version 2
 of the License or (at your option) any later version.
 */
 #pragma once
+#include <atomic>
 #include "inc/Main.h"
 #include "inc/FeatureVal.h"
 
+#if !defined GRAPHITE2_NTHREADS
+#include <pthread.h>
+#endif
+
 namespace graphite2 {
 
 // Forward declarations for implmentation types
 class FeatureMap;
 class Face;
+class SharedFace;
 
 
 class FeatureSetting
@@ -57,7 +63,7 @@ class FeatureRef
 
 public:
     FeatureRef() throw();
-    FeatureRef(const Face & face, unsigned short & bits_offset, uint32 max_val,
+    FeatureRef(const SharedFace & face, unsigned short & bits_offset, uint32 max_val,
                uint32 name, uint16 uiName, uint16 flags,
                FeatureSetting *settings, uint16 num_set) throw();
     ~FeatureRef() throw();
@@ -76,14 +82,14 @@ public:
     uint16 getSettingName(uint16 index) const { return m_nameValues[index].label(); }
     int16  getSettingValue(uint16 index) const { return m_nameValues[index].value(); }
     uint32 maxVal() const { return m_max; }
-    const Face & getFace() const { assert(m_face); return *m_face;}
+    const SharedFace & getFace() const { assert(m_face); return *m_face;}
     const FeatureMap* getFeatureMap() const;// { return m_pFace;}
 
     CLASS_NEW_DELETE;
 private:
     FeatureRef(const FeatureRef & rhs);
 
-    const Face     * m_face;
+    const SharedFace * m_face;
     FeatureSetting * m_nameValues; // array of name table ids for feature values
     chunk_t m_mask,             // bit mask to get the value from the vector
             m_max;              // max value the value can take
@@ -125,11 +131,42 @@ class NameAndFeatureRef
     const FeatureRef* m_pFRef;
 };
 
+// An immutable set of feature values, shared by every segment of a face that
+// is shaped with the same settings. Two shared sets from the same FeatureMap
+// hold the same settings only if they are the same object.
+class SharedFeatures
+{
+    SharedFeatures(const SharedFeatures &);
+    SharedFeatures & operator = (const SharedFeatures &);
+
+public:
+    const Features & features() const { return m_feats; }
+    uint32 value(uint8 findex) const { return findex < m_numFeats ? m_vals[findex] : 0; }
+    uint32 hash() const { return m_hash; }
+    // Drops a reference taken by FeatureMap::share. Safe to call after the
+    // face has been destroyed.
+    void release() const;
+
+    CLASS_NEW_DELETE
+private:
+    friend class FeatureMap;
+    SharedFeatures(const Features & feats, uint32 hash) throw();
+    ~SharedFeatures() throw() { grfree(m_vals); }
+
+    Features                    m_feats;    // packed as the FeatureRefs expect
+    uint32                    * m_vals;     // unpacked, one value per feature of the map
+    SharedFeatures            * m_next;     // next in the same hash bucket
+    const FeatureMap          * m_owner;    // NULL once the map is gone, or if never shared
+    mutable std::atomic<size_t> m_refs;
+    uint32                      m_hash;
+    uint16                      m_numFeats;
+};
+
 class FeatureMap
 {
 public:
-    FeatureMap() : m_numFeats(0), m_feats(NULL), m_pNamedFeats(NULL) {}
-    ~FeatureMap() { delete[] m_feats; delete[] m_pNamedFeats; }
+    FeatureMap();
+    ~FeatureMap();
 
     bool readFeats(const Face & face);
     const FeatureRef *findFeatureRef(uint32 name) const;
@@ -138,14 +175,32 @@ public:
     const FeatureRef *featureRef(byte index) const { return index < m_numFeats ? m_feats + index : NULL; }
     FeatureVal* cloneFeatures(uint32 langname/*0 means default*/) const;      //call destroy_Features when done.
     uint16 numFeats() const { return m_numFeats; };
+    // Returns the shared set holding the same values as feats, creating it if
+    // need be, or NULL if out of memory. Each call must be matched by a call
+    // to SharedFeatures::release.
+    const SharedFeatures *share(const Features & feats) const;
+    // Sets one feature in sf, first swapping sf for a private copy unless it
+    // already is one only the caller holds. Returns false if out of memory,
+    // leaving sf as it was.
+    bool changeFeature(const SharedFeatures * & sf, uint8 findex, uint32 val) const;
     CLASS_NEW_DELETE
 private:
 friend class SillMap;
+    SharedFeatures *newShared(const Features & feats, uint32 hash) const;
+    bool sweepShared() const;
+    bool growShared() const;
+
     uint16 m_numFeats;
 
     FeatureRef *m_feats;
     NameAndFeatureRef* m_pNamedFeats;   //owned
     FeatureVal m_defaultFeatures;        //owned
+    mutable SharedFeatures ** m_shared; // hash buckets of shared feature sets
+    mutable size_t  m_numBuckets,
+                    m_numShared;
+#if !defined GRAPHITE2_NTHREADS
+    mutable pthread_mutex_t m_sharedLock;
+#endif
 
 private:        //defensive on m_feats, m_pNamedFeats, and m_defaultFeatures
     FeatureMap(const FeatureMap&);
@@ -57,6 +57,7 @@ public:
     CLASS_NEW_DELETE
 private:
     friend class FeatureRef;        //so that FeatureRefs can manipulate m_vec directly
+    friend class FeatureMap;        //so that feature sets from different maps are never shared
     const FeatureMap* m_pMap;
 };
 
@@ -29,6 +29,7 @@ of the License or (at your option) any later version.
 #include "graphite2/Font.h"
 #include "inc/Main.h"
 #include "inc/Face.h"
+#include "inc/GlyphCache.h"
 
 namespace graphite2 {
 
@@ -41,30 +42,62 @@ public:
     virtual ~Font();
 
     float advance(unsigned short glyphid) const;
+    void  prefetchAdvances(const uint16 * glyphids, size_t n) const;
+    bool  batchesAdvances() const;
     float scale() const;
     bool isHinted() const;
     const Face & face() const;
-    operator bool () const throw()  { return m_advances; }
+    operator bool () const throw()  { return m_pages || !m_hinted; }
 
     CLASS_NEW_DELETE;
 private:
+    // Hinted advances are cached in pages of this many glyphs, each
+    // allocated the first time one of its glyphs is asked for.
+    enum { PAGE_BITS = 7, PAGE_SIZE = 1 << PAGE_BITS };
+
+    float * cachedAdvance(unsigned short glyphid) const;
+    float * newPage(unsigned short page) const;
+    float   fetchAdvance(unsigned short glyphid) const;
+
     gr_font_ops         m_ops;
     const void  * const m_appFontHandle;
-    float             * m_advances;  // One advance per glyph in pixels. Nan if not defined
+    float            ** m_pages;     // Pages of hinted advances in pixels, INVALID_ADVANCE if not fetched yet. NULL for unhinted fonts
     const Face        & m_face;
     float               m_scale;      // scales from design units to ppm
+    size_t              m_numPages;
     bool                m_hinted;
 
     Font(const Font&);
     Font& operator=(const Font&);
 };
 
+inline
+float * Font::cachedAdvance(unsigned short glyphid) const
+{
+    float * page = m_pages[glyphid >> PAGE_BITS];
+    if (!page && !(page = newPage(glyphid >> PAGE_BITS)))
+        return 0;
+    return page + (glyphid & (PAGE_SIZE - 1));
+}
+
 inline
 float Font::advance(unsigned short glyphid) const
 {
-    if (m_advances[glyphid] == INVALID_ADVANCE)
-        m_advances[glyphid] = (*m_ops.glyph_advance_x)(m_appFontHandle, glyphid);
-    return m_advances[glyphid];
+    if (!m_hinted)
+        return m_face.glyphs().glyph(glyphid)->theAdvance().x * m_scale;
+
+    float * const adv = cachedAdvance(glyphid);
+    if (!adv)
+        return fetchAdvance(glyphid);
+    if (*adv == INVALID_ADVANCE)
+        *adv = fetchAdvance(glyphid);
+    return *adv;
+}
+
+inline
+bool Font::batchesAdvances() const
+{
+    return m_ops.glyph_advances_x != 0;
 }
 
 inline
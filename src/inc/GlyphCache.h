@@ -97,6 +97,11 @@ public:
     GlyphCache(const Face & face, const uint32 face_options);
     ~GlyphCache();
 
+    // Returns a copy of a cache that loads glyphs on demand with every glyph
+    // loaded, or NULL. It only reads the tables the two share, so it can be
+    // made on another thread while this one is in use.
+    GlyphCache    * preload() const;
+
     unsigned short  numGlyphs() const throw();
     unsigned short  numAttrs() const throw();
     unsigned short  unitsPerEm() const throw();
@@ -113,10 +118,14 @@ public:
     const BBox &     getSubBoundingBBox(unsigned short glyphid, uint8 subindex) const;
     bool             check(unsigned short glyphid) const;
     bool             hasBoxes() const { return _boxes != 0; }
+    bool             preloaded() const { return _glyph_loader == 0; }
 
     CLASS_NEW_DELETE;
 
 private:
+    GlyphCache(const Loader & loader);
+    bool preload(const Loader & loader);
+
     const Rect            _empty_slant_box;
     const Loader        * _glyph_loader;
     const GlyphFace *   * _glyphs;
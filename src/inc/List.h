@@ -58,7 +58,7 @@ public:
     Vector(const Vector<T> &rhs)                : m_first(0), m_last(0), m_end(0) { insert(begin(), rhs.begin(), rhs.end()); }
     template <typename I>
     Vector(I first, const I last)               : m_first(0), m_last(0), m_end(0) { insert(begin(), first, last); }
-    ~Vector() { clear(); free(m_first); }
+    ~Vector() { clear(); grfree(m_first); }
 
     iterator            begin()         { return m_first; }
     const_iterator      begin() const   { return m_first; }
@@ -107,7 +107,7 @@ void Vector<T>::reserve(size_t n)
         const ptrdiff_t sz = size();
         size_t requested;
         if (checked_mul(n,sizeof(T), requested))  std::abort();
-        m_first = static_cast<T*>(realloc(m_first, requested));
+        m_first = static_cast<T*>(grrealloc(m_first, requested));
         if (!m_first)   std::abort();
         m_last  = m_first + sz;
         m_end   = m_first + n;
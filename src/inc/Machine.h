@@ -122,7 +122,12 @@ enum opcode {
     BITSET,                         SET_FEAT,
     MAX_OPCODE,
     // private opcodes for internal use only, comes after all other on disk opcodes
-    TEMP_COPY = MAX_OPCODE
+    TEMP_COPY = MAX_OPCODE,
+    RET_BYTE,                       ADD_BYTE,           SUB_BYTE,
+    EQUAL_BYTE,                     NOT_EQ_BYTE,
+    LESS_BYTE,                      GTR_BYTE,           LESS_EQ_BYTE,       GTR_EQ_BYTE,
+    ATTR_SET_BYTE,                  ATTR_SET_SLOT_BYTE, IATTR_SET_BYTE,
+    MAX_PRIVATE_OPCODE
 };
 
 struct opcode_t
@@ -153,7 +158,7 @@ public:
     };
 
     Machine(SlotMap &) throw();
-    static const opcode_t *   getOpcodeTable() throw();
+    static const opcode_t *   getOpcodeTable(bool checked = true) throw();
 
     CLASS_NEW_DELETE;
 
@@ -164,7 +169,7 @@ public:
 private:
     void    check_final_stack(const stack_t * const sp);
     stack_t run(const instr * program, const byte * data,
-                slotref * & map) HOT;
+                slotref * & map, bool checked) HOT;
 
     SlotMap       & _map;
     stack_t         _stack[STACK_MAX + 2*STACK_GUARD];
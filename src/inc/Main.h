@@ -120,8 +120,16 @@ bool checked_mul(const size_t a, const size_t b, size_t & t) {
 }
 #endif
 
-// typesafe wrapper around malloc for simple types
-// use free(pointer) to deallocate
+// All heap memory is allocated through these, which hand it on to the
+// allocator set with gr_set_allocator and account for it to the face and
+// segment being worked on. Blocks from them must be freed with grfree.
+void * grmalloc(size_t bytes);
+void * grcalloc(size_t n, size_t size);
+void * grrealloc(void * p, size_t bytes);
+void   grfree(void * p);
+
+// typesafe wrapper around grmalloc for simple types
+// use grfree(pointer) to deallocate
 
 template <typename T> T * gralloc(size_t n)
 {
@@ -131,7 +139,7 @@ template <typename T> T * gralloc(size_t n)
 #ifdef GRAPHITE2_TELEMETRY
     telemetry::count_bytes(total);
 #endif
-    return static_cast<T*>(malloc(total));
+    return static_cast<T*>(grmalloc(total));
 }
 
 template <typename T> T * grzeroalloc(size_t n)
@@ -139,7 +147,7 @@ template <typename T> T * grzeroalloc(size_t n)
 #ifdef GRAPHITE2_TELEMETRY
     telemetry::count_bytes(sizeof(T) * n);
 #endif
-    return static_cast<T*>(calloc(n, sizeof(T)));
+    return static_cast<T*>(grcalloc(n, sizeof(T)));
 }
 
 template <typename T>
@@ -161,9 +169,9 @@ inline T max(const T a, const T b)
     void * operator new   (size_t, void * p) throw() { return p; } \
     void * operator new[] (size_t size) {return gralloc<byte>(size);} \
     void * operator new[] (size_t, void * p) throw() { return p; } \
-    void operator delete   (void * p) throw() { free(p);} \
+    void operator delete   (void * p) throw() { grfree(p);} \
     void operator delete   (void *, void *) throw() {} \
-    void operator delete[] (void * p)throw() { free(p); } \
+    void operator delete[] (void * p)throw() { grfree(p); } \
     void operator delete[] (void *, void *) throw() {}
 
 #if defined(__GNUC__)  || defined(__clang__)
@@ -0,0 +1,198 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2026, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include "inc/Main.h"
+
+// Under AddressSanitizer arena blocks are fenced off from each other and
+// from the unused part of their chunk, as heap blocks would be.
+#if defined __SANITIZE_ADDRESS__
+#define GRAPHITE2_ASAN
+#elif defined __has_feature
+#if __has_feature(address_sanitizer)
+#define GRAPHITE2_ASAN
+#endif
+#endif
+
+#if defined GRAPHITE2_ASAN
+#include <sanitizer/asan_interface.h>
+#else
+#define ASAN_POISON_MEMORY_REGION(addr, size)   ((void)(addr), (void)(size))
+#define ASAN_UNPOISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#endif
+
+namespace graphite2 {
+
+// The heap memory charged to one face: its own tables and caches and
+// anything made with it, such as segments and fonts, while they live.
+// Every block charged here holds the stats alive, as does the face until
+// it calls release, so blocks may outlive the face that made them.
+class MemoryStats
+{
+public:
+    static MemoryStats * create();
+
+    size_t current() const  { return m_current.load(std::memory_order_relaxed) - 1; }
+    size_t peak() const     { return m_peak.load(std::memory_order_relaxed) - 1; }
+
+    void charge(size_t n);
+    void discharge(size_t n);
+    void release()          { discharge(1); }
+
+    CLASS_NEW_DELETE;
+private:
+    MemoryStats() : m_current(1), m_peak(1) {}
+
+    // Both count the face's own reference as a byte, so neither reaches
+    // zero until the face and every block charged to it are gone.
+    std::atomic<size_t> m_current,
+                        m_peak;
+};
+
+
+// The allocations made while creating one segment.
+struct AllocCounts
+{
+    size_t  allocations,
+            bytes;
+
+    AllocCounts() : allocations(0), bytes(0) {}
+};
+
+
+// Charges the allocations made on this thread, for as long as it lives, to
+// a face and optionally to a segment's counts. Scopes nest, the innermost
+// one wins.
+class MemoryScope
+{
+public:
+    MemoryScope(MemoryStats * stats, AllocCounts * counts = 0) throw();
+    ~MemoryScope() throw();
+
+    static const MemoryScope * current() throw();
+
+    MemoryStats * stats() const throw()     { return m_stats; }
+    AllocCounts * counts() const throw()    { return m_counts; }
+
+private:
+    const MemoryScope * const   m_prev;
+    MemoryStats       * const   m_stats;
+    AllocCounts       * const   m_counts;
+
+    MemoryScope(const MemoryScope &);
+    MemoryScope & operator = (const MemoryScope &);
+};
+
+
+// Bump allocates blocks that are all freed at once, for things such as a
+// segment that make many small allocations and free them together. The
+// chunks come from grmalloc, so they are accounted like any other block.
+// Not thread safe.
+class Arena
+{
+public:
+    explicit Arena(size_t chunk = 0) throw();
+    ~Arena() throw();
+
+    // Sizes the next chunk to hold at least n bytes.
+    void reserve(size_t n) throw()  { if (n > m_chunkSize) m_chunkSize = n; }
+    void * alloc(size_t n) throw();
+    template <typename T> T * alloc(size_t n) throw();
+    template <typename T> T * zeroalloc(size_t n) throw();
+
+    // Users share the arena, which rewinds when the last one releases it.
+    void acquire() throw()          { ++m_users; }
+    void release() throw()          { if (--m_users == 0) rewind(); }
+    // Makes all the memory handed out available again. If that took more
+    // than one chunk they are merged so the same use fits in one next time.
+    void rewind() throw();
+
+    CLASS_NEW_DELETE;
+private:
+    struct Chunk;
+
+    void * grow(size_t n) throw();
+
+#if defined GRAPHITE2_ASAN
+    static const size_t redzone = alignof(std::max_align_t);
+#else
+    static const size_t redzone = 0;
+#endif
+
+    Chunk * m_chunks;
+    byte  * m_next,
+          * m_end;
+    size_t  m_chunkSize,
+            m_users;
+
+    Arena(const Arena &);
+    Arena & operator = (const Arena &);
+};
+
+inline
+void * Arena::alloc(size_t n) throw()
+{
+    const size_t align = alignof(std::max_align_t);
+    if (n > ~size_t(0) - align - redzone) return 0;
+    // Empty blocks still need an address of their own.
+    const size_t size = ((n + align - !!n) & ~(align - 1)) + redzone;
+    byte * p = m_next;
+    if (size > size_t(m_end - m_next))
+    {
+        if (!(p = static_cast<byte *>(grow(size))))
+            return 0;
+    }
+    else
+        m_next += size;
+    ASAN_UNPOISON_MEMORY_REGION(p, n);
+    return p;
+}
+
+template <typename T>
+inline
+T * Arena::alloc(size_t n) throw()
+{
+    size_t bytes;
+    if (checked_mul(n, sizeof(T), bytes)) return 0;
+    return static_cast<T *>(alloc(bytes));
+}
+
+template <typename T>
+inline
+T * Arena::zeroalloc(size_t n) throw()
+{
+    size_t bytes;
+    if (checked_mul(n, sizeof(T), bytes)) return 0;
+    void * const p = alloc(bytes);
+    if (p) memset(p, 0, bytes);
+    return static_cast<T *>(p);
+}
+
+} // namespace graphite2
@@ -39,7 +39,7 @@ class NameTable
 
 public:
     NameTable(const void * data, size_t length, uint16 platfromId=3, uint16 encodingID = 1);
-    ~NameTable() { free(const_cast<TtfUtil::Sfnt::FontNames *>(m_table)); }
+    ~NameTable() { grfree(const_cast<TtfUtil::Sfnt::FontNames *>(m_table)); }
     enum eNameFallback {
         eNoFallback = 0,
         eEnUSFallbackOnly = 1,
@@ -54,12 +54,20 @@ public:
     bool readPass(const byte * pPass, size_t pass_length, size_t subtable_base, Face & face,
         enum passtype pt, uint32 version, Error &e);
     bool runGraphite(vm::Machine & m, FiniteStateMachine & fsm, bool reverse) const;
+    size_t programSize() const;
+    void packPrograms(byte * & out);
     void init(Silf *silf) { m_silf = silf; }
     byte collisionLoops() const { return m_numCollRuns; }
     bool reverseDir() const { return m_isReverseDir; }
+    // Whether running the pass does anything beyond matching rules.
+    bool hasSideEffects() const { return m_numCollRuns || m_kernColls || m_cPConstraint; }
+    bool ignoresGlyph(uint16 gid) const { return !m_numRules || gid >= m_numGlyphs || m_cols[gid] == 0xffffU; }
 
     CLASS_NEW_DELETE
 private:
+    template <bool traced>
+    bool    runRules(Slot * s, vm::Machine &, FiniteStateMachine & fsm) const;
+    template <bool traced>
     void    findNDoRule(Slot* & iSlot, vm::Machine &, FiniteStateMachine& fsm) const;
     int     doAction(const vm::Machine::Code* codeptr, Slot * & slot_out, vm::Machine &) const;
     bool    testPassConstraint(vm::Machine & m) const;
@@ -68,15 +76,23 @@ private:
                      const byte *precontext, const uint16 * sort_key,
                      const uint16 * o_constraint, const byte *constraint_data,
                      const uint16 * o_action, const byte * action_data,
+                     byte * & prog_pool_free, byte * const prog_pool_end,
                      Face &, enum passtype pt, Error &e);
     bool    readStates(const byte * starts, const byte * states, const byte * o_rule_map, Face &, Error &e);
     bool    readRanges(const byte * ranges, size_t num_ranges, Error &e);
+    void    mergeRuleLists();
     uint16  glyphToCol(const uint16 gid) const;
     bool    runFSM(FiniteStateMachine & fsm, Slot * slot) const;
     void    dumpRuleEventConsidered(const FiniteStateMachine & fsm, const RuleEntry & re) const;
     void    dumpRuleEventOutput(const FiniteStateMachine & fsm, const Rule & r, Slot * os) const;
     void    adjustSlot(int delta, Slot * & slot_out, SlotMap &) const;
     bool    collisionShift(Segment *seg, int dir, json * const dbgout) const;
+    bool    collisionShiftPhase1(Segment *seg, Slot *start, Slot * &end, ShiftCollider &coll,
+                     int dir, bool &moved, bool &hasCol, json * const dbgout) const;
+    bool    collisionShiftPhase2(Segment *seg, Slot *start, Slot *end, ShiftCollider &coll,
+                     int dir, bool &moved, bool &hasCol, json * const dbgout) const;
+    bool    collisionShiftParallel(Segment *seg, int dir, bool &res) const;
+    static void collisionShiftChain(void *ctx, size_t n);
     bool    collisionKern(Segment *seg, int dir, json * const dbgout) const;
     bool    collisionFinish(Segment *seg, GR_MAYBE_UNUSED json * const dbgout) const;
     bool    resolveCollisions(Segment *seg, Slot *slot, Slot *start, ShiftCollider &coll, bool isRev,
@@ -88,11 +104,12 @@ private:
     uint16            * m_cols;
     Rule              * m_rules; // rules
     RuleEntry         * m_ruleMap;
+    RuleEntry         * m_mergedRules;
     uint16            * m_startStates; // prectxt length
     uint16            * m_transitions;
     State             * m_states;
     vm::Machine::Code * m_codes;
-    byte              * m_progs;
+    byte              * m_progs;     // load time scratch, see packPrograms
 
     byte   m_numCollRuns;
     byte   m_kernColls;
@@ -83,10 +83,42 @@ struct RuleEntry
 };
 
 
+// Merge two sorted rule lists into out, stopping when out_end is reached.
+inline
+RuleEntry * merge_rules(const RuleEntry * lre, const RuleEntry * const lrend,
+                        const RuleEntry * rre, const RuleEntry * const rrend,
+                        RuleEntry * out, const RuleEntry * const out_end)
+{
+  if (rre == rrend)
+  {
+    while (lre != lrend && out != out_end) { *out++ = *lre++; }
+    return out;
+  }
+  while (lre != lrend && out != out_end)
+  {
+    if (*lre < *rre)      *out++ = *lre++;
+    else if (*rre < *lre) { *out++ = *rre++; }
+    else                { *out++ = *lre++; ++rre; }
+
+    if (rre == rrend)
+    {
+      while (lre != lrend && out != out_end) { *out++ = *lre++; }
+      return out;
+    }
+  }
+  while (rre != rrend && out != out_end) { *out++ = *rre++; }
+  return out;
+}
+
+
 struct State
 {
   const RuleEntry     * rules,
                       * rules_end;
+  // The candidate list the FSM holds on reaching this state, if it is the
+  // same whichever way the state is reached, otherwise null.
+  const RuleEntry     * merged,
+                      * merged_end;
 
   bool   empty() const;
 };
@@ -153,9 +185,9 @@ private:
       void accumulate_rules(const State &state);
 
   private:
-      RuleEntry * m_begin,
-                * m_end,
-                  m_rules[MAX_RULES*2];
+      const RuleEntry * m_begin,
+                      * m_end;
+      RuleEntry         m_rules[MAX_RULES*2];
   };
 
 public:
@@ -220,27 +252,18 @@ void FiniteStateMachine::Rules::accumulate_rules(const State &state)
   // Only bother if there are rules in the State object.
   if (state.empty()) return;
 
-  // Merge the new sorted rules list into the current sorted result set.
-  const RuleEntry * lre = begin(), * rre = state.rules;
-  RuleEntry * out = m_rules + (m_begin == m_rules)*MAX_RULES;
-  const RuleEntry * const lrend = out + MAX_RULES,
-                  * const rrend = state.rules_end;
-  m_begin = out;
-  while (lre != end() && out != lrend)
+  // Use the list worked out at load time when there is one.
+  if (state.merged)
   {
-    if (*lre < *rre)      *out++ = *lre++;
-    else if (*rre < *lre) { *out++ = *rre++; }
-    else                { *out++ = *lre++; ++rre; }
-
-    if (rre == rrend)
-    {
-      while (lre != end() && out != lrend) { *out++ = *lre++; }
-      m_end = out;
-      return;
-    }
+    m_begin = state.merged;
+    m_end = state.merged_end;
+    return;
   }
-  while (rre != rrend && out != lrend) { *out++ = *rre++; }
-  m_end = out;
+
+  // Merge the new sorted rules list into the current sorted result set.
+  RuleEntry * const out = m_rules + (m_begin == m_rules)*MAX_RULES;
+  m_end = merge_rules(begin(), end(), state.rules, state.rules_end, out, out + MAX_RULES);
+  m_begin = out;
 }
 
 inline
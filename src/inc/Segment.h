@@ -38,19 +38,19 @@ of the License or (at your option) any later version.
 #include "inc/Slot.h"
 #include "inc/Position.h"
 #include "inc/List.h"
+#include "inc/Memory.h"
 #include "inc/Collider.h"
 
 #define MAX_SEG_GROWTH_FACTOR  64
 
 namespace graphite2 {
 
-typedef Vector<Features>        FeatureList;
-typedef Vector<Slot *>          SlotRope;
-typedef Vector<int16 *>         AttributeRope;
-typedef Vector<SlotJustify *>   JustifyRope;
+typedef Vector<const SharedFeatures *> FeatureList;
 
 class Font;
+class JustifyTotal;
 class Segment;
+class ShapingContext;
 class Silf;
 
 enum SpliceParam {
@@ -85,7 +85,19 @@ public:
 
     enum {
         SEG_INITCOLLISIONS = 1,
-        SEG_HASCOLLISIONS = 2
+        SEG_HASCOLLISIONS = 2,
+        SEG_INERT = 4           // no glyph can match a rule, see Silf::inertGlyph
+    };
+
+    // The layout Slot::clusterMetric last did. Laying out a cluster also
+    // moves its slots, so only the most recent one can be reused as is.
+    struct ClusterCache
+    {
+        const Slot    * slot;       // NULL when there is nothing cached
+        Rect            bbox;
+        Position        advance;
+        uint8           attrLevel;
+        bool            rtl;
     };
 
     size_t slotCount() const { return m_numGlyphs; }      //one slot per glyph
@@ -94,11 +106,18 @@ public:
     bool runGraphite() { if (m_silf) return m_face->runGraphite(this, m_silf); else return true;};
     void chooseSilf(uint32 script) { m_silf = m_face->chooseSilf(script); }
     const Silf *silf() const { return m_silf; }
+    ShapingContext *context() const { return m_context; }
+    void context(ShapingContext *ctx) { m_context = ctx; }
+    const AllocCounts & allocs() const { return m_allocs; }
+    void allocs(const AllocCounts & a) { m_allocs = a; }
+    Arena * sharedArena() const { return m_arena != &m_ownArena ? m_arena : 0; }
+    size_t slotsHighWater() const { return m_slotsHighWater; }
+    size_t slotPoolSize() const { return m_slotPoolSize; }
     size_t charInfoCount() const { return m_numCharinfo; }
     const CharInfo *charinfo(unsigned int index) const { return index < m_numCharinfo ? m_charinfo + index : NULL; }
     CharInfo *charinfo(unsigned int index) { return index < m_numCharinfo ? m_charinfo + index : NULL; }
 
-    Segment(size_t numchars, const Face* face, uint32 script, int dir);
+    Segment(size_t numchars, const Face* face, uint32 script, int dir, Arena * arena = 0);
     ~Segment();
     uint8 flags() const { return m_flags; }
     void flags(uint8 f) { m_flags = f; }
@@ -116,15 +135,9 @@ public:
     void linkClusters(Slot *first, Slot *last);
     uint16 getClassGlyph(uint16 cid, uint16 offset) const { return m_silf->getClassGlyph(cid, offset); }
     uint16 findClassIndex(uint16 cid, uint16 gid) const { return m_silf->findClassIndex(cid, gid); }
-    int addFeatures(const Features& feats) { m_feats.push_back(feats); return int(m_feats.size()) - 1; }
-    uint32 getFeature(int index, uint8 findex) const { const FeatureRef* pFR=m_face->theSill().theFeatureMap().featureRef(findex); if (!pFR) return 0; else return pFR->getFeatureVal(m_feats[index]); }
-    void setFeature(int index, uint8 findex, uint32 val) {
-        const FeatureRef* pFR=m_face->theSill().theFeatureMap().featureRef(findex);
-        if (pFR)
-        {
-            if (val > pFR->maxVal()) val = pFR->maxVal();
-            pFR->applyValToFeature(val, m_feats[index]);
-        } }
+    int addFeatures(const Features& feats);
+    uint32 getFeature(int index, uint8 findex) const { return m_feats[index]->value(findex); }
+    bool setFeature(int index, uint8 findex, uint32 val);
     int8 dir() const { return m_dir; }
     void dir(int8 val) { m_dir = val; }
     bool currdir() const { return ((m_dir >> 6) ^ m_dir) & 1; }
@@ -138,43 +151,62 @@ public:
     int numAttrs() const { return m_silf->numUser(); }
     int defaultOriginal() const { return m_defaultOriginal; }
     const Face * getFace() const { return m_face; }
-    const Features & getFeatures(unsigned int /*charIndex*/) { assert(m_feats.size() == 1); return m_feats[0]; }
+    const Features & getFeatures(unsigned int /*charIndex*/) { assert(m_feats.size() == 1); return m_feats[0]->features(); }
     void bidiPass(int paradir, uint8 aMirror);
     int8 getSlotBidiClass(Slot *s) const;
     void doMirror(uint16 aMirror);
     Slot *addLineEnd(Slot *nSlot);
     void delLineEnd(Slot *s);
-    bool hasJustification() const { return m_justifies.size() != 0; }
     void reverseSlots();
 
     bool isWhitespace(const int cid) const;
     bool hasCollisionInfo() const { return (m_flags & SEG_HASCOLLISIONS) && m_collisions; }
     SlotCollision *collisionInfo(const Slot *s) const { return m_collisions ? m_collisions + s->index() : 0; }
+    ClusterCache & clusterCache() const { return m_clusterCache; }
+    void invalidateClusterCache() const { m_clusterCache.slot = 0; }
+    void invalidatePositions() { m_positioned.valid = false; }
     CLASS_NEW_DELETE
 
 public:       //only used by: GrSegment* makeAndInitialize(const GrFont *font, const GrFace *face, uint32 script, const FeaturesHandle& pFeats/*must not be IsNull*/, encform enc, const void* pStart, size_t nChars, int dir);
     bool read_text(const Face *face, const Features* pFeats/*must not be NULL*/, gr_encform enc, const void*pStart, size_t nChars);
     void finalise(const Font *font, bool reverse=false);
     float justify(Slot *pSlot, const Font *font, float width, enum justFlags flags, Slot *pFirst, Slot *pLast);
+    void justifyLines(ShapingContext *ctx, const Font *font, size_t numLines, Slot * const * starts, const float * widths, enum justFlags flags, float * results);
+    size_t breakLines(float width, int maxWeight, bool totalFit, size_t maxLines, const Slot ** breaks, float * widths) const;
     bool initCollisions();
 
 private:
+    float justifyLine(Vector<JustifyTotal> & stats, Slot *pSlot, const Font *font, float width, enum justFlags flags, Slot *pFirst, Slot *pLast);
+    Position positionCluster(Slot *s, const Font *font, Position base, Rect &bbox, float &clusterMin, bool isRtl, bool isFinal);
+
     Position        m_advance;          // whole segment advance
-    SlotRope        m_slots;            // Vector of slot buffers
-    AttributeRope   m_userAttrs;        // Vector of userAttrs buffers
-    JustifyRope     m_justifies;        // Slot justification info buffers
-    FeatureList     m_feats;            // feature settings referenced by charinfos in this segment
+    Arena           m_ownArena;         // used unless the caller supplies an arena
+    Arena         * m_arena;            // all the slot, attribute, justification, charinfo and collision buffers
+    FeatureList     m_feats;            // feature settings referenced by charinfos in this segment, shared with the face until a rule sets one
     Slot          * m_freeSlots;        // linked list of free slots
     SlotJustify   * m_freeJustifies;    // Slot justification blocks free list
     CharInfo      * m_charinfo;         // character info, one per input character
     SlotCollision * m_collisions;
+    mutable ClusterCache m_clusterCache;  // see Slot::clusterMetric
+    struct
+    {
+        const Font    * font;
+        bool            valid,
+                        rtl,
+                        isFinal;
+    }               m_positioned;       // what positionSlots last laid the slots out for
     const Face    * m_face;             // GrFace
     const Silf    * m_silf;
+    ShapingContext * m_context;         // working storage to shape with, only set while shaping
     Slot          * m_first;            // first slot in segment
     Slot          * m_last;             // last slot in segment
     size_t          m_bufSize,          // how big a buffer to create when need more slots
                     m_numGlyphs,
-                    m_numCharinfo;      // size of the array and number of input characters
+                    m_numCharinfo,      // size of the array and number of input characters
+                    m_slotsInUse,
+                    m_slotsHighWater,   // most slots in use at once
+                    m_slotPoolSize;     // slots allocated from m_arena
+    AllocCounts     m_allocs;           // heap use while the segment was made
     int             m_defaultOriginal;  // number of whitespace chars in the string
     int8            m_dir;
     uint8           m_flags,            // General purpose flags
@@ -234,3 +266,4 @@ bool Segment::isWhitespace(const int cid) const
 } // namespace graphite2
 
 struct gr_segment : public graphite2::Segment {};
+struct gr_segment_arena : public graphite2::Arena {};
@@ -0,0 +1,81 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2011, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#pragma once
+
+#include <cstdlib>
+#include "inc/Main.h"
+#include "inc/Machine.h"
+#include "inc/Rule.h"
+
+namespace graphite2 {
+
+// Working storage for shaping a segment. The slot map, rule buffer and
+// machine are built afresh in it for every segment, which is cheap, but
+// there rather than on the stack. The scratch buffer, used by the bidi
+// resolver, is kept and grown between segments.  Not thread safe: each
+// thread needs its own.
+class ShapingContext
+{
+    ShapingContext(const ShapingContext &);
+    ShapingContext & operator = (const ShapingContext &);
+
+public:
+    ShapingContext() throw() : m_scratch(0), m_scratchSize(0) {}
+    ~ShapingContext() throw() { grfree(m_scratch); }
+
+    void * slotMap() throw()    { return m_map; }
+    void * fsm() throw()        { return m_fsm; }
+    void * machine() throw()    { return m_machine; }
+    byte * scratch(size_t n) throw();
+
+    CLASS_NEW_DELETE
+
+private:
+    alignas(SlotMap)            byte m_map[sizeof(SlotMap)];
+    alignas(FiniteStateMachine) byte m_fsm[sizeof(FiniteStateMachine)];
+    alignas(vm::Machine)        byte m_machine[sizeof(vm::Machine)];
+    byte  * m_scratch;
+    size_t  m_scratchSize;
+};
+
+// Returns a buffer of at least n bytes that stays valid until the next call.
+inline
+byte * ShapingContext::scratch(size_t n) throw()
+{
+    if (n > m_scratchSize)
+    {
+        grfree(m_scratch);
+        m_scratchSize = max(n, 2*m_scratchSize);
+        m_scratch = gralloc<byte>(m_scratchSize);
+        if (!m_scratch) m_scratchSize = 0;
+    }
+    return m_scratch;
+}
+
+} // namespace graphite2
+
+struct gr_shaping_context : public graphite2::ShapingContext {};
@@ -0,0 +1,109 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2026, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#pragma once
+
+#include <atomic>
+#include "inc/Main.h"
+#include "inc/FeatureMap.h"
+
+namespace graphite2 {
+
+class Cmap;
+class Face;
+class GlyphCache;
+class NameTable;
+class Silf;
+
+// The loaded form of a font: its features, glyphs, cmap cache and Silf
+// passes. A face normally loads one of its own, but faces made to share
+// their tables look for one in a process wide registry first, keyed by an
+// identity the application gives or else by a hash of the font's tables,
+// and hold a reference to it. Registered ones are fully preloaded, so
+// nothing in them changes after that and any number of faces, on any
+// threads, can use them at once.
+class SharedFace
+{
+    SharedFace(const SharedFace &);
+    SharedFace & operator = (const SharedFace &);
+
+public:
+    // Empty tables for face to load. Those with a key, which they take
+    // ownership of, may be published for other faces to share.
+    explicit SharedFace(const Face & face, byte * key = 0, size_t key_length = 0) throw();
+
+    // Finds the registered tables for face's font, with a new reference on
+    // them, or returns empty ones for face to load and then publish. Id, if
+    // not NULL, identifies the font, otherwise its tables' contents do.
+    // Returns NULL if out of memory.
+    static SharedFace * lookup(const Face & face, const void * id, size_t id_length);
+
+    // Registers freshly loaded tables for other faces to find. If another
+    // face registered the same font meanwhile ours are released and its
+    // tables returned in their place.
+    SharedFace * publish();
+    void release();
+
+    // Preloads tables loaded on demand, with a direct cmap, and swaps them in
+    // for the demand loaded ones, which are kept until we go for any call
+    // still using them. Only reads what those already fetched, so it can run
+    // on another thread while they are in use.
+    void preload();
+
+    bool                loaded() const throw()  { return m_glyphs.load(std::memory_order_relaxed) != 0; }
+    bool                preloaded() const throw() { return m_preloaded.load(std::memory_order_acquire); }
+    const SillMap     & theSill() const throw() { return m_Sill; }
+    const GlyphCache  & glyphs() const throw()  { return *m_glyphs.load(std::memory_order_acquire); }
+    Cmap              & cmap() const throw()    { return *m_cmap.load(std::memory_order_acquire); }
+    NameTable         * nameTable() const;
+    const Silf        * silfs() const throw()   { return m_silfs; }
+    uint16              numSilfs() const throw(){ return m_numSilf; }
+
+    CLASS_NEW_DELETE;
+private:
+    friend class Face;
+    ~SharedFace() throw();
+
+    bool shareable() const throw();
+
+    SillMap             m_Sill;
+    std::atomic<GlyphCache *> m_glyphs;
+    std::atomic<Cmap *> m_cmap;
+    GlyphCache        * m_demandGlyphs; // replaced by preloaded ones
+    Cmap              * m_demandCmap;
+    mutable NameTable * m_names;
+    Silf              * m_silfs;
+    const Face        * m_loader;       // reads the name table on demand, NULL once registered
+    SharedFace        * m_next;         // next in the registry
+    byte              * m_key;          // owned, NULL if never to be shared
+    size_t              m_keyLength;
+    std::atomic<size_t> m_refs;
+    std::atomic<bool>   m_preloaded;
+    uint16              m_numSilf;
+    bool                m_registered;
+};
+
+} // namespace graphite2
@@ -99,18 +99,23 @@ public:
     Justinfo *justAttrs() const { return m_justs; }
     uint16 endLineGlyphid() const { return m_gEndLine; }
     const gr_faceinfo *silfInfo() const { return &m_silfinfo; }
+    bool canSkipPasses() const { return m_inert != 0; }
+    bool inertGlyph(uint16 gid) const { return m_inert && gid < m_numInert && (m_inert[gid >> 5] >> (gid & 31)) & 1; }
 
     CLASS_NEW_DELETE;
 
 private:
     size_t readClassMap(const byte *p, size_t data_len, uint32 version, Error &e);
     template<typename T> inline uint32 readClassOffsets(const byte *&p, size_t data_len, Error &e);
+    bool runPasses(Segment *seg, vm::Machine &m, FiniteStateMachine &fsm, size_t maxSize, uint8 firstPass, uint8 lastPass, int dobidi) const;
 
     Pass          * m_passes;
     Pseudo        * m_pseudos;
     uint32        * m_classOffsets;
     uint16        * m_classData;
     Justinfo      * m_justs;
+    byte          * m_progs;
+    uint32        * m_inert;        // glyphs no pass can match a rule on
     uint8           m_numPasses;
     uint8           m_numJusts;
     uint8           m_sPass, m_pPass, m_jPass, m_bPass,
@@ -119,7 +124,7 @@ private:
     uint8       m_aPseudo, m_aBreak, m_aUser, m_aBidi, m_aMirror, m_aPassBits,
                 m_iMaxComp, m_aCollision;
     uint16      m_aLig, m_numPseudo, m_nClass, m_nLinear,
-                m_gEndLine;
+                m_gEndLine, m_numInert;
     gr_faceinfo m_silfinfo;
 
     void releaseBuffers() throw();
@@ -51,7 +51,10 @@ public:
 
     void LoadSlot(const Slot *s, const Segment *seg);
 
-    SlotJustify *next;
+    union {
+        SlotJustify *next;  // while on the segment's free list
+        size_t refs;        // while in use, the number of slots sharing it
+    };
     int16 values[1];
 };
 
@@ -72,7 +75,7 @@ public:
     unsigned short gid() const { return m_glyphid; }
     Position origin() const { return m_position; }
     float advance() const { return m_advance.x; }
-    void advance(Position &val) { m_advance = val; }
+    void advance(Position &val) { m_advance = val; invalidatePosition(); }
     Position advancePos() const { return m_advance; }
     int before() const { return m_before; }
     int after() const { return m_after; }
@@ -87,22 +90,24 @@ public:
     void prev(Slot *s) { m_prev = s; }
     uint16 glyph() const { return m_realglyphid ? m_realglyphid : m_glyphid; }
     void setGlyph(Segment *seg, uint16 glyphid, const GlyphFace * theGlyph = NULL);
-    void setRealGid(uint16 realGid) { m_realglyphid = realGid; }
-    void adjKern(const Position &pos) { m_shift = m_shift + pos; m_advance = m_advance + pos; }
-    void origin(const Position &pos) { m_position = pos + m_shift; }
+    void setRealGid(uint16 realGid) { m_realglyphid = realGid; invalidatePosition(); }
+    void adjKern(const Position &pos) { m_shift = m_shift + pos; m_advance = m_advance + pos; invalidatePosition(); }
+    void origin(const Position &pos) { m_position = pos + m_shift; invalidatePosition(); }
+    void position(const Position &pos) { m_position = pos; invalidatePosition(); }
     void originate(int ind) { m_original = ind; }
     int original() const { return m_original; }
     void before(int ind) { m_before = ind; }
     void after(int ind) { m_after = ind; }
     bool isBase() const { return (!m_parent); }
     void update(int numSlots, int numCharInfo, Position &relpos);
-    Position finalise(const Segment* seg, const Font* font, Position & base, Rect & bbox, uint8 attrLevel, float & clusterMin, bool rtl, bool isFinal, int depth = 0);
+    Position finalise(const Segment* seg, const Font* font, Position & base, Rect & bbox, uint8 attrLevel, float & clusterMin, bool rtl, bool isFinal);
     bool isDeleted() const { return (m_flags & DELETED) ? true : false; }
     void markDeleted(bool state) { if (state) m_flags |= DELETED; else m_flags &= ~DELETED; }
     bool isCopied() const { return (m_flags & COPIED) ? true : false; }
     void markCopied(bool state) { if (state) m_flags |= COPIED; else m_flags &= ~COPIED; }
     bool isPositioned() const { return (m_flags & POSITIONED) ? true : false; }
     void markPositioned(bool state) { if (state) m_flags |= POSITIONED; else m_flags &= ~POSITIONED; }
+    void invalidatePosition();
     bool isInsertBefore() const { return !(m_flags & INSERTED); }
     uint8 getBidiLevel() const { return m_bidiLevel; }
     void setBidiLevel(uint8 level) { m_bidiLevel = level; }
@@ -117,6 +122,8 @@ public:
     int getJustify(const Segment *seg, uint8 level, uint8 subindex) const;
     void setJustify(Segment *seg, uint8 level, uint8 subindex, int16 value);
     bool isLocalJustify() const { return m_justs != NULL; };
+    void shareJustify() { if (m_justs) ++m_justs->refs; }
+    void releaseJustify(Segment *seg);
     void attachTo(Slot *ap) { m_parent = ap; }
     Slot *attachedTo() const { return m_parent; }
     Position attachOffset() const { return m_attach - m_with; }
@@ -128,10 +135,10 @@ public:
     bool sibling(Slot *ap);
     bool removeChild(Slot *ap);
     int32 clusterMetric(const Segment* seg, uint8 metric, uint8 attrLevel, bool rtl);
-    void positionShift(Position a) { m_position += a; }
-    void floodShift(Position adj, int depth = 0);
+    void positionShift(Position a) { m_position += a; invalidatePosition(); }
+    void floodShift(Position adj);
     float just() const { return m_just; }
-    void just(float j) { m_just = j; }
+    void just(float j) { m_just = j; invalidatePosition(); }
     Slot *nextInCluster(const Slot *s) const;
     bool isChildOf(const Slot *base) const;
 
@@ -154,6 +161,8 @@ private:
     Position m_advance;     // .advance slot attribute
     Position m_attach;      // attachment point on us
     Position m_with;        // attachment point position on parent
+    Position m_layoutBase;  // where this cluster was last laid out from, base slots only
+    Position m_layoutEnd;   // and where that layout left the next cluster to start
     float    m_just;        // Justification inserted space
     uint8    m_flags;       // holds bit flags
     byte     m_attLevel;    // attachment level
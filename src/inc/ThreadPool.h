@@ -0,0 +1,84 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#pragma once
+
+#include "inc/Main.h"
+#include "inc/Memory.h"
+
+#if !defined GRAPHITE2_NTHREADS
+#include <pthread.h>
+#endif
+
+namespace graphite2 {
+
+// A small fixed size pool of worker threads used to spread independent pieces
+// of per segment work across cores. The calling thread always takes part in
+// the work, so a pool with no workers simply runs everything in the caller.
+class ThreadPool
+{
+    ThreadPool(const ThreadPool &);
+    ThreadPool & operator = (const ThreadPool &);
+
+public:
+    typedef void (*task_fn)(void * ctx, size_t n);
+
+    ThreadPool(size_t num_workers);
+    ~ThreadPool();
+
+    // Call fn(ctx, i) for each i in [0, n) and wait for all of them to finish.
+    // Returns false, having run nothing, if the pool is already busy with
+    // another caller's work.
+    bool    run(task_fn fn, void * ctx, size_t n);
+    size_t  workers() const throw() { return m_numWorkers; }
+
+    static size_t default_workers();
+
+    CLASS_NEW_DELETE
+
+#if !defined GRAPHITE2_NTHREADS
+private:
+    static void * worker(void * pool);
+    void    drain();
+
+    pthread_t     * m_threads;
+    pthread_mutex_t m_lock,
+                    m_busy;
+    pthread_cond_t  m_wake,
+                    m_done;
+    task_fn         m_fn;
+    void          * m_ctx;
+    MemoryStats   * m_memory;           // what the caller charges its allocations to
+    size_t          m_next,
+                    m_end,
+                    m_pending;
+    unsigned int    m_generation;
+    bool            m_quit;
+#endif
+    size_t          m_numWorkers;
+};
+
+} // namespace graphite2
@@ -285,7 +285,7 @@ public:
                     assert(len >= 0);
                     mLangLookup[a][b][len] = old[len];
                 }
-                free(old);
+                grfree(old);
             }
             else
             {
@@ -302,7 +302,7 @@ public:
     {
         for (int i = 0; i != 26; ++i)
             for (int j = 0; j != 26; ++j)
-                free(mLangLookup[i][j]);
+                grfree(mLangLookup[i][j]);
     }
     unsigned short getMsId(const char * locale) const
     {
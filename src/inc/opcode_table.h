@@ -120,5 +120,18 @@ static const opcode_t opcode_table[] =
     {{do2(setbits)},                                4, "BITSET"},
     {{do_(set_feat), NILOP},                        2, "SET_FEAT"},                 // featidx slot
     // private opcodes for internal use only, comes after all other on disk opcodes.
-    {{do_(temp_copy), NILOP},                       0, "TEMP_COPY"}
+    {{do_(temp_copy), NILOP},                       0, "TEMP_COPY"},
+    // a PUSH_BYTE folded into the following instruction
+    {{do2(ret_byte)},                               1, "RET_BYTE"},                 // number
+    {{do2(add_byte)},                               1, "ADD_BYTE"},                 // number
+    {{do2(sub_byte)},                               1, "SUB_BYTE"},                 // number
+    {{do2(equal_byte)},                             1, "EQUAL_BYTE"},               // number
+    {{do2(not_eq_byte)},                            1, "NOT_EQ_BYTE"},              // number
+    {{do2(less_byte)},                              1, "LESS_BYTE"},                // number
+    {{do2(gtr_byte)},                               1, "GTR_BYTE"},                 // number
+    {{do2(less_eq_byte)},                           1, "LESS_EQ_BYTE"},             // number
+    {{do2(gtr_eq_byte)},                            1, "GTR_EQ_BYTE"},              // number
+    {{do_(attr_set_byte), NILOP},                   2, "ATTR_SET_BYTE"},            // number sattrnum
+    {{do_(attr_set_slot_byte), NILOP},              2, "ATTR_SET_SLOT_BYTE"},       // number sattrnum
+    {{do_(iattr_set_byte), NILOP},                  3, "IATTR_SET_BYTE"}            // number sattrnum attrid
 };
@@ -252,9 +252,12 @@ STARTOP(put_copy)
         {
             int16 *tempUserAttrs = is->userAttrs();
             if (is->attachedTo() || is->firstChild()) DIE
+            seg.invalidateClusterCache();
             Slot *prev = is->prev();
             Slot *next = is->next();
             memcpy(tempUserAttrs, ref->userAttrs(), seg.numAttrs() * sizeof(uint16));
+            is->releaseJustify(&seg);
+            ref->shareJustify();
             memcpy(is, ref, sizeof(Slot));
             is->firstChild(NULL);
             is->nextSibling(NULL);
@@ -263,6 +266,7 @@ STARTOP(put_copy)
             is->prev(prev);
             if (is->attachedTo())
                 is->attachedTo()->child(is);
+            is->invalidatePosition();
         }
         is->markCopied(false);
         is->markDeleted(false);
@@ -650,6 +654,7 @@ STARTOP(temp_copy)
     slotref newSlot = seg.newSlot();
     if (!newSlot || !is) DIE;
     int16 *tempUserAttrs = newSlot->userAttrs();
+    is->shareJustify();
     memcpy(newSlot, is, sizeof(Slot));
     memcpy(tempUserAttrs, is->userAttrs(), seg.numAttrs() * sizeof(uint16));
     newSlot->userAttrs(tempUserAttrs);
@@ -686,6 +691,71 @@ STARTOP(set_feat)
     if (slot)
     {
         uint8 fid = seg.charinfo(slot->original())->fid();
-        seg.setFeature(fid, feat, pop());
+        if (!seg.setFeature(fid, feat, pop())) DIE
     }
 ENDOP
+
+// Private opcodes the loader substitutes for a PUSH_BYTE and the instruction
+// consuming its value, which becomes the first parameter.
+#define bytebinop(op)       declare_params(1); *sp = uint32(*sp) op uint32(int8(*param))
+#define sbytebinop(op)      declare_params(1); *sp = int32(*sp) op int32(int8(*param))
+
+STARTOP(ret_byte)
+    declare_params(1);
+    EXIT(uint32(int8(*param)));
+ENDOP
+
+STARTOP(add_byte)
+    bytebinop(+);
+ENDOP
+
+STARTOP(sub_byte)
+    bytebinop(-);
+ENDOP
+
+STARTOP(equal_byte)
+    bytebinop(==);
+ENDOP
+
+STARTOP(not_eq_byte)
+    bytebinop(!=);
+ENDOP
+
+STARTOP(less_byte)
+    sbytebinop(<);
+ENDOP
+
+STARTOP(gtr_byte)
+    sbytebinop(>);
+ENDOP
+
+STARTOP(less_eq_byte)
+    sbytebinop(<=);
+ENDOP
+
+STARTOP(gtr_eq_byte)
+    sbytebinop(>=);
+ENDOP
+
+STARTOP(attr_set_byte)
+    declare_params(2);
+    const          int  val  = int8(param[0]);
+    const attrCode      slat = attrCode(uint8(param[1]));
+    is->setAttr(&seg, slat, 0, val, smap);
+ENDOP
+
+STARTOP(attr_set_slot_byte)
+    declare_params(2);
+    const attrCode  slat   = attrCode(uint8(param[1]));
+    const int       offset = int(map - smap.begin())*int(slat == gr_slatAttTo);
+    const int       val    = int8(param[0]) + offset;
+    is->setAttr(&seg, slat, offset, val, smap);
+ENDOP
+
+STARTOP(iattr_set_byte)
+    declare_params(3);
+    const          int  val  = int8(param[0]);
+    const attrCode      slat = attrCode(uint8(param[1]));
+    const uint8         idx  = uint8(param[2]);
+    is->setAttr(&seg, slat, idx, val, smap);
+ENDOP
@@ -36,6 +36,7 @@ using gr_face_ptr = std::unique_ptr<gr_face, decltype(&gr_face_destroy)>;
 using gr_font_ptr = std::unique_ptr<gr_font, decltype(&gr_font_destroy)>;
 using gr_feature_val_ptr = std::unique_ptr<gr_feature_val, decltype(&gr_featureval_destroy)>;
 using gr_segment_ptr = std::unique_ptr<gr_segment, decltype(&gr_seg_destroy)>;
+using gr_shaping_context_ptr = std::unique_ptr<gr_shaping_context, decltype(&gr_shaping_context_destroy)>;
 
 class Gr2Face : public gr_face_ptr
 {
@@ -65,6 +66,7 @@ public:
 		m_grFace(std::move(face)),
 		m_grFont(nullptr, &gr_font_destroy),
 		m_grFeatures(nullptr, gr_featureval_destroy),
+		m_grContext(gr_make_shaping_context(), &gr_shaping_context_destroy),
 		m_name("graphite2")
 	{
 		if (!m_grFace)
@@ -100,8 +102,8 @@ public:
 			std::cerr << "Invalid Unicode pos" << int(static_cast<const char*>(pError) - utf8) << std::endl;
 
 		gr_segment_ptr pSeg = gr_segment_ptr(
-				gr_make_seg(m_grFont.get(), m_grFace.get(), 0u, m_grFeatures.get(),
-										gr_utf8, utf8, numCodePoints, m_rtl),
+				gr_make_seg_with_context(m_grContext.get(), m_grFont.get(), m_grFace.get(), 0u,
+										m_grFeatures.get(), gr_utf8, utf8, numCodePoints, m_rtl),
 				&gr_seg_destroy);
 
 		if (!pSeg)
@@ -129,4 +131,5 @@ public:
 		bool 					 			m_rtl;
 		gr_font_ptr 				m_grFont;
 		gr_feature_val_ptr	m_grFeatures;
+		gr_shaping_context_ptr	m_grContext;
 	};
@@ -0,0 +1,136 @@
+#include <graphite2/Segment.h>
+#include <stdio.h>
+#include <string.h>
+
+/* The client's idea of each glyph's hinted advance, whole pixels as a
+   hinting rasteriser would give. */
+static float hinted_advance(gr_uint16 gid)
+{
+    return (float)(5 + (gid * 7) % 13);
+}
+
+struct client
+{
+    int calls;                      /* how often the font asked */
+    int glyphs;                     /* how many advances it asked for */
+    int again;                      /* how many of those it had asked for before */
+    unsigned char asked[65536];
+};
+
+static void note(struct client *c, gr_uint16 gid)
+{
+    ++c->glyphs;
+    if (c->asked[gid]++) ++c->again;
+}
+
+static float advance_fn(const void *appFontHandle, gr_uint16 glyphid)
+{
+    struct client *c = (struct client *)appFontHandle;
+    ++c->calls;
+    note(c, glyphid);
+    return hinted_advance(glyphid);
+}
+
+static void advances_fn(const void *appFontHandle, const gr_uint16 *glyphids, size_t count, float *advances)
+{
+    struct client *c = (struct client *)appFontHandle;
+    size_t i;
+    ++c->calls;
+    for (i = 0; i != count; ++i)
+    {
+        note(c, glyphids[i]);
+        advances[i] = hinted_advance(glyphids[i]);
+    }
+}
+
+/* Do two segments have the same glyphs in the same places? */
+static int same_slots(const gr_segment *a, const gr_segment *b)
+{
+    const gr_slot *s = gr_seg_first_slot((gr_segment *)a), *t = gr_seg_first_slot((gr_segment *)b);
+    if (gr_seg_advance_X(a) != gr_seg_advance_X(b)) return 0;
+    for (; s && t; s = gr_slot_next_in_segment(s), t = gr_slot_next_in_segment(t))
+        if (gr_slot_gid(s) != gr_slot_gid(t) || gr_slot_origin_X(s) != gr_slot_origin_X(t)
+            || gr_slot_origin_Y(s) != gr_slot_origin_Y(t))
+            return 0;
+    return !s && !t;
+}
+
+/* Does every glyph advance as far through both fonts, and never by the
+   placeholder the cache holds while a batch is being fetched? */
+static int same_advances(const gr_segment *seg, const gr_face *face, const gr_font *a, const gr_font *b)
+{
+    const gr_slot *s;
+    for (s = gr_seg_first_slot((gr_segment *)seg); s; s = gr_slot_next_in_segment(s))
+    {
+        const float adv = gr_slot_advance_X(s, face, a);
+        if (adv != gr_slot_advance_X(s, face, b) || adv < -1e30f) return 0;
+    }
+    return 1;
+}
+
+static struct client batched, single;
+
+/* usage: ./advances fontfile.ttf string */
+int main(int argc, char **argv)
+{
+    static const gr_font_ops batch_ops = {sizeof(gr_font_ops), 0, 0, &advances_fn};
+    static const gr_font_ops single_ops = {sizeof(gr_font_ops), &advance_fn, 0, 0};
+    gr_uint32 wide[0x250 - 0x21];
+    gr_face *face;
+    gr_font *batch, *perglyph;
+    gr_segment *seg, *other;
+    const void *pError;
+    size_t numCodePoints;
+    int calls, pages = 0, i;
+
+    if (argc < 3) return 1;
+    face = gr_make_file_face(argv[1], 0);
+    if (!face) return 2;
+    batch = gr_make_font_with_ops(12, &batched, &batch_ops, face);
+    perglyph = gr_make_font_with_ops(12, &single, &single_ops, face);
+    if (!batch || !perglyph) return 3;
+
+    numCodePoints = gr_count_unicode_characters(gr_utf8, argv[2], NULL, &pError);
+    if (pError) return 4;
+
+    /* The batched callback gives what the per glyph one does, asking for a
+       glyph once however many times the string uses it. */
+    seg = gr_make_seg(batch, face, 0, 0, gr_utf8, argv[2], numCodePoints, 0);
+    other = gr_make_seg(perglyph, face, 0, 0, gr_utf8, argv[2], numCodePoints, 0);
+    if (!seg || !other) return 5;
+    if (!same_slots(seg, other) || !same_advances(seg, face, batch, perglyph)) return 6;
+    if (!batched.calls || batched.again) return 7;
+    if (batched.glyphs >= (int)gr_seg_n_slots(seg)) return 8;
+    gr_seg_destroy(other);
+    gr_seg_destroy(seg);
+
+    /* Glyphs it already has it does not ask for again. */
+    calls = batched.calls;
+    seg = gr_make_seg(batch, face, 0, 0, gr_utf8, argv[2], numCodePoints, 0);
+    if (!seg || !same_advances(seg, face, batch, perglyph)) return 9;
+    if (batched.calls != calls) return 10;
+    gr_seg_destroy(seg);
+
+    /* A run of Latin glyphs spread across many pages of the advance cache,
+       each fetched the once through either callback. */
+    for (i = 0; i != sizeof(wide) / sizeof(wide[0]); ++i)
+        wide[i] = 0x21 + i;
+    seg = gr_make_seg(batch, face, 0, 0, gr_utf32, wide, sizeof(wide) / sizeof(wide[0]), 0);
+    other = gr_make_seg(perglyph, face, 0, 0, gr_utf32, wide, sizeof(wide) / sizeof(wide[0]), 0);
+    if (!seg || !other) return 11;
+    if (!same_slots(seg, other) || !same_advances(seg, face, batch, perglyph)) return 12;
+    if (batched.again || single.again) return 13;
+    for (i = 0; i != 65536 / 128; ++i)        /* the cache keeps 128 advances a page */
+        if (memchr(single.asked + i * 128, 1, 128)) ++pages;
+    if (pages < 3) return 14;
+    gr_seg_destroy(other);
+    gr_seg_destroy(seg);
+
+    printf("%d batched calls for %d advances, %d single calls over %d pages\n",
+           batched.calls, batched.glyphs, single.calls, pages);
+
+    gr_font_destroy(perglyph);
+    gr_font_destroy(batch);
+    gr_face_destroy(face);
+    return 0;
+}
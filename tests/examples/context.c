@@ -0,0 +1,70 @@
+#include <graphite2/Segment.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Do two segments have the same glyphs in the same places? */
+static int same_slots(const gr_segment *a, const gr_segment *b)
+{
+    const gr_slot *s = gr_seg_first_slot((gr_segment *)a), *t = gr_seg_first_slot((gr_segment *)b);
+    if (gr_seg_advance_X(a) != gr_seg_advance_X(b)) return 0;
+    for (; s && t; s = gr_slot_next_in_segment(s), t = gr_slot_next_in_segment(t))
+        if (gr_slot_gid(s) != gr_slot_gid(t) || gr_slot_origin_X(s) != gr_slot_origin_X(t)
+            || gr_slot_origin_Y(s) != gr_slot_origin_Y(t))
+            return 0;
+    return !s && !t;
+}
+
+/* Does shaping with the context give what shaping without one does? */
+static int shape_both(gr_shaping_context *ctx, const gr_font *font, const gr_face *face,
+                      const char *text, size_t len, int dir)
+{
+    const void *pError;
+    const size_t numCodePoints = gr_count_unicode_characters(gr_utf8, text, text + len, &pError);
+    gr_segment *plain, *reused;
+    int res;
+
+    if (pError) return 0;
+    plain = gr_make_seg(font, face, 0, 0, gr_utf8, text, numCodePoints, dir);
+    reused = gr_make_seg_with_context(ctx, font, face, 0, 0, gr_utf8, text, numCodePoints, dir);
+    res = plain && reused && same_slots(plain, reused);
+    gr_seg_destroy(reused);
+    gr_seg_destroy(plain);
+    return res;
+}
+
+/* usage: ./context fontfile.ttf string */
+int main(int argc, char **argv)
+{
+    static const int dirs[] = {0, 1, gr_fullbidi, 1 | gr_fullbidi};
+    gr_face *face;
+    gr_font *font;
+    gr_shaping_context *ctx;
+    const char *word, *end;
+    int d, n = 0;
+
+    if (argc < 3) return 1;
+    face = gr_make_file_face(argv[1], 0);
+    if (!face) return 2;
+    font = gr_make_font(12, face);
+    ctx = gr_make_shaping_context();
+    if (!font || !ctx) return 3;
+
+    /* One context serves every word of the string and then the whole of it,
+       in each direction and through the built in bidi */
+    for (d = 0; d != sizeof(dirs) / sizeof(dirs[0]); ++d)
+    {
+        for (word = argv[2]; *word; word = *end ? end + 1 : end, ++n)
+        {
+            if (!(end = strchr(word, ' '))) end = word + strlen(word);
+            if (!shape_both(ctx, font, face, word, end - word, dirs[d])) return 4;
+        }
+        if (!shape_both(ctx, font, face, argv[2], strlen(argv[2]), dirs[d])) return 5;
+        ++n;
+    }
+    printf("%d segments shaped the same with and without a context\n", n);
+
+    gr_shaping_context_destroy(ctx);
+    gr_font_destroy(font);
+    gr_face_destroy(face);
+    return 0;
+}
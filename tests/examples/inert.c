@@ -0,0 +1,60 @@
+#include <graphite2/Segment.h>
+#include <stdio.h>
+
+/* Do two segments have the same glyphs in the same places? */
+static int same_slots(const gr_segment *a, const gr_segment *b)
+{
+    const gr_slot *s = gr_seg_first_slot((gr_segment *)a), *t = gr_seg_first_slot((gr_segment *)b);
+    if (gr_seg_advance_X(a) != gr_seg_advance_X(b)) return 0;
+    for (; s && t; s = gr_slot_next_in_segment(s), t = gr_slot_next_in_segment(t))
+        if (gr_slot_gid(s) != gr_slot_gid(t) || gr_slot_origin_X(s) != gr_slot_origin_X(t)
+            || gr_slot_origin_Y(s) != gr_slot_origin_Y(t))
+            return 0;
+    return !s && !t;
+}
+
+/* usage: ./inert fontfile.ttf inert-string reference-string
+
+   The font's passes match none of the glyphs of the first string, but
+   mirroring swaps in glyphs they do match, the very ones that mirroring
+   makes of the second string.  So the passes must run on both, and give
+   the same result, even though the first segment starts out with nothing
+   for them to do.
+
+   PigLatinMirror.ttf is PigLatinBenchmark_v3.ttf with directionality as
+   its mirroring attribute, which maps letters to glyph 1, and with
+   "one" mirrored to "B" and "two" to glyph 1. */
+int main(int argc, char **argv)
+{
+    const int dir = gr_rtl | gr_nobidi;     /* mirror without a bidi pass */
+    gr_face *face;
+    gr_font *font;
+    gr_segment *seg, *ref;
+    const void *pError;
+    size_t len;
+
+    if (argc < 4) return 1;
+    face = gr_make_file_face(argv[1], 0);
+    if (!face) return 2;
+    font = gr_make_font(12, face);
+    if (!font) return 3;
+
+    len = gr_count_unicode_characters(gr_utf8, argv[2], NULL, &pError);
+    if (pError || gr_count_unicode_characters(gr_utf8, argv[3], NULL, &pError) != len || pError)
+        return 4;
+    seg = gr_make_seg(font, face, 0, 0, gr_utf8, argv[2], len, dir);
+    ref = gr_make_seg(font, face, 0, 0, gr_utf8, argv[3], len, dir);
+    if (!seg || !ref) return 5;
+
+    /* The passes ran, inserting glyphs, and ran as they do for the reference */
+    if (gr_seg_n_slots(ref) <= len) return 6;
+    if (!same_slots(seg, ref)) return 7;
+    printf("%u slots from %u characters, as for the reference\n",
+           gr_seg_n_slots(seg), (unsigned)len);
+
+    gr_seg_destroy(ref);
+    gr_seg_destroy(seg);
+    gr_font_destroy(font);
+    gr_face_destroy(face);
+    return 0;
+}
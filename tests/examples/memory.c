@@ -0,0 +1,112 @@
+#include <graphite2/Segment.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* A host allocator that keeps count of what graphite has outstanding */
+struct tally
+{
+    size_t blocks, bytes;
+};
+
+static void *tally_alloc(void *handle, size_t bytes)
+{
+    struct tally *t = (struct tally *)handle;
+    void *p = malloc(bytes);
+    if (p) { ++t->blocks; t->bytes += bytes; }
+    return p;
+}
+
+static void tally_free(void *handle, void *p, size_t bytes)
+{
+    struct tally *t = (struct tally *)handle;
+    --t->blocks; t->bytes -= bytes;
+    free(p);
+}
+
+/* Do two segments have the same glyphs in the same places? */
+static int same_slots(const gr_segment *a, const gr_segment *b)
+{
+    const gr_slot *s = gr_seg_first_slot((gr_segment *)a), *t = gr_seg_first_slot((gr_segment *)b);
+    for (; s && t; s = gr_slot_next_in_segment(s), t = gr_slot_next_in_segment(t))
+        if (gr_slot_gid(s) != gr_slot_gid(t) || gr_slot_origin_X(s) != gr_slot_origin_X(t)
+            || gr_slot_origin_Y(s) != gr_slot_origin_Y(t))
+            return 0;
+    return !s && !t;
+}
+
+/* usage: ./memory fontfile.ttf string */
+int main(int argc, char **argv)
+{
+    struct tally t = {0, 0};
+    const gr_allocator_ops ops = {sizeof(gr_allocator_ops), &tally_alloc, NULL, &tally_free};
+    char *pError;
+    size_t numCodePoints;
+    gr_face *face, *shared, *other;
+    gr_font *font, *sfont;
+    gr_segment *seg, *first, *second;
+    gr_segment_arena *arena;
+    size_t loaded, shaped, warm;
+
+    if (argc < 3) return 1;
+    if (!gr_set_allocator(&ops, &t)) return 2;                                  /*<1>*/
+    face = gr_make_file_face(argv[1], 0);
+    if (!face) return 3;
+    loaded = gr_face_memory_current(face);                                      /*<2>*/
+    if (!loaded || loaded > t.bytes) return 4;
+
+    font = gr_make_font(12, face);
+    if (!font) return 5;
+    numCodePoints = gr_count_unicode_characters(gr_utf8, argv[2], NULL, (const void **)(&pError));
+    if (pError) return 6;
+    seg = gr_make_seg(font, face, 0, 0, gr_utf8, argv[2], numCodePoints, 0);
+    if (!seg) return 7;
+    shaped = gr_face_memory_current(face);
+    printf("face %zu bytes, peak %zu, segment %zu allocations of %zu bytes, %u of %u slots\n",
+           shaped, gr_face_memory_peak(face), gr_seg_n_allocations(seg),
+           gr_seg_bytes_allocated(seg), gr_seg_slots_high_water(seg), gr_seg_slot_pool_size(seg));
+    if (shaped <= loaded || gr_face_memory_peak(face) < shaped) return 8;      /*<3>*/
+    if (!gr_seg_n_allocations(seg) || gr_seg_slots_high_water(seg) < gr_seg_n_slots(seg)
+        || gr_seg_slot_pool_size(seg) < gr_seg_slots_high_water(seg)) return 9;
+
+    /* Segments in an arena shape the same, and once the arena has been used
+       and rewound the next ones take hardly anything from the heap */
+    arena = gr_make_segment_arena(0);
+    if (!arena) return 10;
+    first = gr_make_seg_in_arena(arena, NULL, font, face, 0, 0, gr_utf8, argv[2], numCodePoints, 0);
+    second = gr_make_seg_in_arena(arena, NULL, font, face, 0, 0, gr_utf8, argv[2], numCodePoints, 0);
+    if (!first || !second || !same_slots(seg, first) || !same_slots(seg, second)) return 11;
+    gr_seg_destroy(first);
+    gr_seg_destroy(second);
+    first = gr_make_seg_in_arena(arena, NULL, font, face, 0, 0, gr_utf8, argv[2], numCodePoints, 0);
+    if (!first || !same_slots(seg, first)) return 12;
+    warm = gr_seg_n_allocations(first);
+    printf("in a warm arena %zu allocations\n", warm);
+    if (warm >= gr_seg_n_allocations(seg)) return 13;
+    gr_seg_destroy(first);
+    gr_segment_arena_destroy(arena);
+
+    /* Faces that share their tables load them once, and keep them for as long
+       as any of them is alive */
+    shared = gr_make_file_face(argv[1], gr_face_shareTables);
+    other = gr_make_file_face(argv[1], gr_face_shareTables);
+    if (!shared || !other) return 14;
+    printf("shared face %zu bytes, the next one %zu bytes\n",
+           gr_face_memory_current(shared), gr_face_memory_current(other));
+#if !defined GRAPHITE2_NTHREADS
+    if (gr_face_memory_current(other) * 4 >= gr_face_memory_current(shared)) return 15;
+#endif
+    gr_face_destroy(shared);
+    sfont = gr_make_font(12, other);
+    if (!sfont) return 16;
+    first = gr_make_seg(sfont, other, 0, 0, gr_utf8, argv[2], numCodePoints, 0);
+    if (!first || !same_slots(seg, first)) return 17;
+    gr_seg_destroy(first);
+    gr_font_destroy(sfont);
+    gr_face_destroy(other);
+
+    gr_seg_destroy(seg);
+    gr_font_destroy(font);
+    gr_face_destroy(face);
+    if (t.blocks || t.bytes) return 18;                                         /*<4>*/
+    return !gr_set_allocator(NULL, NULL);
+}
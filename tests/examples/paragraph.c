@@ -0,0 +1,100 @@
+#include <graphite2/Segment.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* sum of the squared slack of all but the last line */
+float raggedness(const float *widths, size_t numlines, float width)
+{
+    float res = 0;
+    size_t i;
+    for (i = 0; i + 1 < numlines; i++)
+        res += (width - widths[i]) * (width - widths[i]);
+    return res;
+}
+
+/* usage: ./paragraph fontfile.ttf width string */
+int main(int argc, char **argv)
+{
+    int rtl = 0;                /* are we rendering right to left? probably not */
+    int pointsize = 12;         /* point size in points */
+    int dpi = 96;               /* work with this many dots per inch */
+    int width = atoi(argv[2]) * dpi / 72;  /* linewidth in points */
+
+    char *pError;               /* location of faulty utf-8 */
+    gr_font *font = NULL;
+    size_t numCodePoints = 0;
+    gr_segment * seg = NULL, * batch = NULL;
+    gr_shaping_context *ctx;
+    const gr_slot *s, *t, **lineslots, **batchslots;
+    float *greedy, *widths, *targets;
+    size_t i, numgreedy, numlines;
+    gr_face *face = gr_make_file_face(argv[1], 0);
+    if (!face) return 1;
+    font = gr_make_font(pointsize * dpi / 72.0f, face);
+    if (!font) return 2;
+    numCodePoints = gr_count_unicode_characters(gr_utf8, argv[3], NULL,
+                (const void **)(&pError));
+    if (pError) return 3;
+    ctx = gr_make_shaping_context();
+    if (!ctx) return 3;
+    seg = gr_make_seg(font, face, 0, 0, gr_utf8, argv[3], numCodePoints, rtl);
+    batch = gr_make_seg_with_context(ctx, font, face, 0, 0, gr_utf8, argv[3], numCodePoints, rtl);
+    if (!seg || !batch) return 3;
+
+    /* There won't be more lines than characters in the text. */
+    lineslots = (const gr_slot **)malloc(numCodePoints * sizeof(gr_slot *));
+    batchslots = (const gr_slot **)malloc(numCodePoints * sizeof(gr_slot *));
+    greedy = (float *)malloc(numCodePoints * sizeof(float));
+    widths = (float *)malloc(numCodePoints * sizeof(float));
+    targets = (float *)malloc(numCodePoints * sizeof(float));
+    numgreedy = gr_seg_break_lines(seg, (float)width, gr_breakWord,
+                gr_linebreakGreedy, numCodePoints, NULL, greedy);               /*<1>*/
+    numlines = gr_seg_break_lines(seg, (float)width, gr_breakWord,
+                gr_linebreakTotalFit, numCodePoints, lineslots, widths);        /*<2>*/
+    if (numlines < 2 || lineslots[0] != gr_seg_first_slot(seg)) return 4;
+    for (i = 0; i < numlines; i++)
+        if (widths[i] > width) return 5;
+    if (raggedness(widths, numlines, (float)width) > raggedness(greedy, numgreedy, (float)width))
+        return 6;
+    if (gr_seg_break_lines(batch, (float)width, gr_breakWord,
+                gr_linebreakTotalFit, numCodePoints, batchslots, NULL) != numlines)
+        return 7;
+
+    printf("%d:", width);
+    for (i = 1; i < numlines; i++)
+    {
+        gr_slot_linebreak_before((gr_slot *)lineslots[i]);                      /*<3>*/
+        gr_slot_linebreak_before((gr_slot *)batchslots[i]);
+    }
+    for (i = 0; i < numlines; i++)
+    {
+        gr_seg_justify(seg, lineslots[i], font, width, 0, NULL, NULL);          /*<4>*/
+        targets[i] = (float)width;
+    }
+    gr_seg_justify_lines(batch, ctx, font, numlines, batchslots, targets, 0, NULL); /*<5>*/
+    for (i = 0; i < numlines; i++)
+    {
+        printf("%.2f/", widths[i]);
+        for (s = lineslots[i], t = batchslots[i]; s && t;
+                s = gr_slot_next_in_segment(s), t = gr_slot_next_in_segment(t))
+        {
+            if (gr_slot_gid(s) != gr_slot_gid(t) || gr_slot_origin_X(s) != gr_slot_origin_X(t)
+                    || gr_slot_origin_Y(s) != gr_slot_origin_Y(t))
+                return 8;
+            printf("%d(%.2f,%.2f) ", gr_slot_gid(s), gr_slot_origin_X(s), gr_slot_origin_Y(s));
+        }
+        if (s || t) return 8;
+        printf("\n");
+    }
+    free((void*)lineslots);
+    free((void*)batchslots);
+    free(greedy);
+    free(widths);
+    free(targets);
+    gr_seg_destroy(batch);
+    gr_seg_destroy(seg);
+    gr_shaping_context_destroy(ctx);
+    gr_font_destroy(font);
+    gr_face_destroy(face);
+    return 0;
+}
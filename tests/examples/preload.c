@@ -0,0 +1,65 @@
+#include <graphite2/Segment.h>
+#include <stdio.h>
+
+/* Do two segments have the same glyphs in the same places? */
+static int same_slots(const gr_segment *a, const gr_segment *b)
+{
+    const gr_slot *s = gr_seg_first_slot((gr_segment *)a), *t = gr_seg_first_slot((gr_segment *)b);
+    for (; s && t; s = gr_slot_next_in_segment(s), t = gr_slot_next_in_segment(t))
+        if (gr_slot_gid(s) != gr_slot_gid(t) || gr_slot_origin_X(s) != gr_slot_origin_X(t)
+            || gr_slot_origin_Y(s) != gr_slot_origin_Y(t))
+            return 0;
+    return !s && !t;
+}
+
+static gr_segment *shape(gr_face *face, gr_font *font, const char *text)
+{
+    return gr_make_seg(font, face, 0, 0, gr_utf8, text,
+                       gr_count_unicode_characters(gr_utf8, text, NULL, NULL), 0);
+}
+
+/* usage: ./preload fontfile.ttf string */
+int main(int argc, char **argv)
+{
+    gr_face *face, *async, *demand;
+    gr_font *font, *afont;
+    gr_segment *seg, *early, *late;
+
+    if (argc < 3) return 1;
+    face = gr_make_file_face(argv[1], gr_face_preloadAll);
+    demand = gr_make_file_face(argv[1], gr_face_default);
+    if (!face || !demand) return 2;
+    if (!gr_face_is_preloaded(face) || gr_face_is_preloaded(demand)
+        || gr_face_wait_preloaded(demand)) return 3;
+    font = gr_make_font(12, face);
+    seg = shape(face, font, argv[2]);
+    if (!font || !seg) return 4;
+
+    /* A face preloading in the background shapes the same before and after
+       it switches to its preloaded glyphs and cmap */
+    async = gr_make_file_face(argv[1], gr_face_preloadAsync);
+    if (!async) return 5;
+    afont = gr_make_font(12, async);
+    early = shape(async, afont, argv[2]);
+    if (!afont || !early || !same_slots(seg, early)) return 6;
+    if (!gr_face_wait_preloaded(async) || !gr_face_is_preloaded(async)) return 7;
+    late = shape(async, afont, argv[2]);
+    if (!late || !same_slots(seg, late) || !same_slots(early, late)) return 8;
+    printf("preloaded in the background, %zu bytes\n", gr_face_memory_current(async));
+
+    gr_seg_destroy(late);
+    gr_seg_destroy(early);
+    gr_font_destroy(afont);
+    gr_face_destroy(async);
+
+    /* Destroying a face waits for its preloading */
+    async = gr_make_file_face(argv[1], gr_face_preloadAsync);
+    if (!async) return 9;
+    gr_face_destroy(async);
+
+    gr_seg_destroy(seg);
+    gr_font_destroy(font);
+    gr_face_destroy(demand);
+    gr_face_destroy(face);
+    return 0;
+}
@@ -264,6 +264,37 @@ template <class T> void testFeatTable(const T & table, const char * testName)
                        table.m_settings[settingsIndex+j].m_label);
         }
     }
+    testAssert("test missing feat\n", !testFeatureMap.findFeatureRef(0x7A7A7A7A));
+
+    FeatureVal feats;
+    for (uint16 i = 0; i < testFeatureMap.numFeats(); ++i)
+        testFeatureMap.feature(i)->applyValToFeature(testFeatureMap.feature(i)->maxVal(), feats);
+    const SharedFeatures * a = testFeatureMap.share(feats),
+                         * b = testFeatureMap.share(feats);
+    testAssert("test share feats\n", a && b);
+#if !defined GRAPHITE2_NTHREADS
+    testAssert("test interned feats\n", a == b);
+#endif
+    testAssertEqual("test shared hash %u %u\n", a->hash(), b->hash());
+    for (uint16 i = 0; i < testFeatureMap.numFeats(); ++i)
+        testAssertEqual("test shared value %u %u\n", a->value(uint8(i)), testFeatureMap.feature(i)->maxVal());
+
+    // Changing a feature copies the shared set once, then writes to the copy.
+    if (testFeatureMap.numFeats())
+    {
+        const SharedFeatures * c = b;
+        testAssert("test change feat\n", testFeatureMap.changeFeature(c, 0, 0));
+        testAssert("test changed copy\n", c != a);
+        testAssertEqual("test changed value %u %u\n", c->value(0), 0u);
+        testAssertEqual("test original value %u %u\n", a->value(0), testFeatureMap.feature(0)->maxVal());
+        const SharedFeatures * const own = c;
+        testAssert("test change again\n", testFeatureMap.changeFeature(c, 0, testFeatureMap.feature(0)->maxVal()));
+        testAssert("test changed in place\n", c == own);
+        testAssertEqual("test changed back %u %u\n", c->value(0), testFeatureMap.feature(0)->maxVal());
+        b = c;
+    }
+    a->release();
+    b->release();
     gr_face_destroy(face);
 }
 
@@ -66,6 +66,10 @@ fn('gr_face_destroy', None, c_void_p)
 fn('gr_face_n_glyphs', c_ushort, c_void_p)
 fn('gr_face_info', POINTER(FaceInfo), c_void_p)
 fn('gr_face_is_char_supported', c_int, c_void_p, c_uint32, c_uint32)
+fn('gr_face_memory_current', c_size_t, c_void_p)
+fn('gr_face_memory_peak', c_size_t, c_void_p)
+fn('gr_face_is_preloaded', c_int, c_void_p)
+fn('gr_face_wait_preloaded', c_int, c_void_p)
 fn('gr_make_file_face', c_void_p, c_char_p, c_uint)
 fn('gr_make_font', c_void_p, c_float, c_void_p)
 fn('gr_make_font_with_advance_fn', c_void_p, c_float, c_void_p, advfn, c_void_p)
@@ -89,14 +93,26 @@ fn('gr_cinfo_base', c_size_t, c_void_p)
 fn('gr_count_unicode_characters', c_size_t, c_int, c_void_p, c_void_p, POINTER(c_void_p))
 fn('gr_make_seg', c_void_p, c_void_p, c_void_p, c_uint32, c_void_p, c_int, c_void_p, c_size_t, c_int)
 fn('gr_seg_destroy', None, c_void_p)
+fn('gr_make_shaping_context', c_void_p)
+fn('gr_shaping_context_destroy', None, c_void_p)
+fn('gr_make_seg_with_context', c_void_p, c_void_p, c_void_p, c_void_p, c_uint32, c_void_p, c_int, c_void_p, c_size_t, c_int)
+fn('gr_make_segment_arena', c_void_p, c_size_t)
+fn('gr_segment_arena_destroy', None, c_void_p)
+fn('gr_make_seg_in_arena', c_void_p, c_void_p, c_void_p, c_void_p, c_void_p, c_uint32, c_void_p, c_int, c_void_p, c_size_t, c_int)
 fn('gr_seg_advance_X', c_float, c_void_p)
 fn('gr_seg_advance_Y', c_float, c_void_p)
 fn('gr_seg_n_cinfo', c_uint, c_void_p)
 fn('gr_seg_cinfo', c_void_p, c_void_p, c_uint)
 fn('gr_seg_n_slots', c_uint, c_void_p)
+fn('gr_seg_n_allocations', c_size_t, c_void_p)
+fn('gr_seg_bytes_allocated', c_size_t, c_void_p)
+fn('gr_seg_slots_high_water', c_uint, c_void_p)
+fn('gr_seg_slot_pool_size', c_uint, c_void_p)
 fn('gr_seg_first_slot', c_void_p, c_void_p)
 fn('gr_seg_last_slot', c_void_p, c_void_p)
 fn('gr_seg_justify', c_float, c_void_p, c_void_p, c_void_p, c_double, c_int, c_void_p, c_void_p)
+fn('gr_seg_justify_lines', None, c_void_p, c_void_p, c_void_p, c_size_t, POINTER(c_void_p), POINTER(c_float), c_int, POINTER(c_float))
+fn('gr_seg_break_lines', c_size_t, c_void_p, c_float, c_int, c_int, c_size_t, POINTER(c_void_p), POINTER(c_float))
 fn('gr_slot_next_in_segment', c_void_p, c_void_p)
 fn('gr_slot_prev_in_segment', c_void_p, c_void_p)
 fn('gr_slot_attached_to', c_void_p, c_void_p)
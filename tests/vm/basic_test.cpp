@@ -98,7 +98,9 @@ int main(int argc, char *argv[])
               << prog.dataSize() + prog.instructionCount()*sizeof(instr)
               << " bytes" << std::endl
               << "                        "
-              << prog.instructionCount() << " instructions" << std::endl;
+              << prog.instructionCount() << " instructions" << std::endl
+              << "stack use verified:     "
+              << (prog.verified() ? "yes" : "no") << std::endl;
 
     // run the program
     Segment seg;
@@ -108,6 +110,7 @@ int main(int argc, char *argv[])
     Machine m(smap);
     smap.pushSlot(&s1);
     slotref * map = smap.begin();
+    const clock_t start = clock();
     for(size_t n = repeats; n; --n) {
         ret = prog.run(m, map);
         switch (m.status()) {
@@ -138,12 +141,17 @@ int main(int argc, char *argv[])
         }
     }
 
+    const double elapsed = double(clock() - start)/CLOCKS_PER_SEC;
     gr_face_destroy(face);
 
     std::cout << "result of program: " << ret << std::endl
               << "--------" << std::endl
               << "equivalent of " << prog.instructionCount()*repeats
               << " instructions executed" << std::endl;
+    if (elapsed > 0)
+        std::cout << "                        "
+                  << size_t(prog.instructionCount()*repeats/elapsed)
+                  << " instructions per second" << std::endl;
 
     return 0;
 }